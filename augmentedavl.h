@@ -0,0 +1,362 @@
+#ifndef AUGMENTEDAVL_H
+#define AUGMENTEDAVL_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstddef>
+#include <limits>
+#include "avlbst.h"
+
+/*
+  -------------------------------------------------
+  Monoids for AugmentedAVLTree.
+
+  A monoid says what to keep per subtree: type is the aggregate,
+  identity() the aggregate of an empty subtree, lift(key, value) that of
+  one item, and combine(a, b) that of a subtree whose items are a's
+  followed by b's. combine must be associative; it need not commute.
+  -------------------------------------------------
+*/
+
+/**
+* Number of items in the subtree, for order statistics.
+*/
+template <class Key, class Value>
+struct SubtreeSize
+{
+    typedef size_t type;
+    type identity() const { return 0; }
+    type lift(const Key&, const Value&) const { return 1; }
+    type combine(const type& a, const type& b) const { return a + b; }
+};
+
+template <class Key, class Value>
+struct ValueSum
+{
+    typedef Value type;
+    type identity() const { return Value(); }
+    type lift(const Key&, const Value& value) const { return value; }
+    type combine(const type& a, const type& b) const { return a + b; }
+};
+
+template <class Key, class Value>
+struct ValueMin
+{
+    typedef Value type;
+    type identity() const { return std::numeric_limits<Value>::max(); }
+    type lift(const Key&, const Value& value) const { return value; }
+    type combine(const type& a, const type& b) const { return (b < a) ? b : a; }
+};
+
+template <class Key, class Value>
+struct ValueMax
+{
+    typedef Value type;
+    type identity() const { return std::numeric_limits<Value>::lowest(); }
+    type lift(const Key&, const Value& value) const { return value; }
+    type combine(const type& a, const type& b) const { return (a < b) ? b : a; }
+};
+
+/**
+* An AVL node that also stores the aggregate of its subtree.
+*/
+template <typename Key, typename Value, typename Aggregate>
+class AugmentedAVLNode : public AVLNode<Key, Value>
+{
+public:
+    AugmentedAVLNode(const Key& key, const Value& value, const Aggregate& aggregate);
+    virtual ~AugmentedAVLNode();
+
+    const Aggregate& getAggregate() const;
+    void setAggregate(const Aggregate& aggregate);
+
+    virtual AugmentedAVLNode<Key, Value, Aggregate>* getParent() const override;
+    virtual AugmentedAVLNode<Key, Value, Aggregate>* getLeft() const override;
+    virtual AugmentedAVLNode<Key, Value, Aggregate>* getRight() const override;
+
+protected:
+    Aggregate aggregate_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the AugmentedAVLNode class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value, class Aggregate>
+AugmentedAVLNode<Key, Value, Aggregate>::AugmentedAVLNode(const Key& key, const Value& value, const Aggregate& aggregate) :
+        AVLNode<Key, Value>(key, value, NULL), aggregate_(aggregate)
+{
+
+}
+
+template<class Key, class Value, class Aggregate>
+AugmentedAVLNode<Key, Value, Aggregate>::~AugmentedAVLNode()
+{
+
+}
+
+template<class Key, class Value, class Aggregate>
+const Aggregate& AugmentedAVLNode<Key, Value, Aggregate>::getAggregate() const
+{
+    return aggregate_;
+}
+
+template<class Key, class Value, class Aggregate>
+void AugmentedAVLNode<Key, Value, Aggregate>::setAggregate(const Aggregate& aggregate)
+{
+    aggregate_ = aggregate;
+}
+
+template<class Key, class Value, class Aggregate>
+AugmentedAVLNode<Key, Value, Aggregate> *AugmentedAVLNode<Key, Value, Aggregate>::getParent() const
+{
+    return static_cast<AugmentedAVLNode<Key, Value, Aggregate>*>(this->parent_);
+}
+
+template<class Key, class Value, class Aggregate>
+AugmentedAVLNode<Key, Value, Aggregate> *AugmentedAVLNode<Key, Value, Aggregate>::getLeft() const
+{
+    return static_cast<AugmentedAVLNode<Key, Value, Aggregate>*>(this->left_);
+}
+
+template<class Key, class Value, class Aggregate>
+AugmentedAVLNode<Key, Value, Aggregate> *AugmentedAVLNode<Key, Value, Aggregate>::getRight() const
+{
+    return static_cast<AugmentedAVLNode<Key, Value, Aggregate>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the AugmentedAVLNode class.
+  -----------------------------------------------
+*/
+
+/**
+* An AVL tree that keeps a monoid aggregate of every subtree, kept up to
+* date through the AVLTree hooks: rotations and joins recompute the nodes
+* they relink, and insert and remove recompute the path to the root, so
+* updates stay O(log n). Everything AVLTree does (batches, bulk loads)
+* keeps the aggregates right.
+*
+* Values changed in place through find or operator[] are not seen; use
+* insert to overwrite a value.
+*/
+template <class Key, class Value, class Monoid>
+class AugmentedAVLTree : public AVLTree<Key, Value>
+{
+public:
+    typedef typename Monoid::type Aggregate;
+    typedef AugmentedAVLNode<Key, Value, Aggregate> AugNode;
+
+    explicit AugmentedAVLTree(const Monoid& monoid = Monoid());
+
+    Aggregate rangeAggregate(const Key& lo, const Key& hi) const;
+    Aggregate aggregate() const;
+
+protected:
+    virtual void nodeSwap(AVLNode<Key, Value>* n1, AVLNode<Key, Value>* n2);
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value);
+    virtual void refreshNode(AVLNode<Key, Value>* node);
+    virtual void refreshPath(AVLNode<Key, Value>* node);
+    virtual size_t nodeSize() const;
+    virtual Node<Key, Value>* relocateNode(Node<Key, Value>* node, NodeArena& arena);
+
+    Aggregate aggregateOf(AugNode* node) const;
+
+    Monoid monoid_;
+};
+
+template<class Key, class Value, class Monoid>
+AugmentedAVLTree<Key, Value, Monoid>::AugmentedAVLTree(const Monoid& monoid) : monoid_(monoid)
+{
+
+}
+
+template<class Key, class Value, class Monoid>
+typename AugmentedAVLTree<Key, Value, Monoid>::Aggregate
+AugmentedAVLTree<Key, Value, Monoid>::aggregateOf(AugNode* node) const
+{
+    return (node == NULL) ? monoid_.identity() : node->getAggregate();
+}
+
+template<class Key, class Value, class Monoid>
+AVLNode<Key, Value>* AugmentedAVLTree<Key, Value, Monoid>::createNode(const Key& key, const Value& value)
+{
+    return new AugNode(key, value, monoid_.lift(key, value));
+}
+
+template<class Key, class Value, class Monoid>
+void AugmentedAVLTree<Key, Value, Monoid>::refreshNode(AVLNode<Key, Value>* node)
+{
+    AugNode* current = static_cast<AugNode*>(node);
+    current->setAggregate(monoid_.combine(
+            monoid_.combine(aggregateOf(current->getLeft()), monoid_.lift(current->getKey(), current->getValue())),
+            aggregateOf(current->getRight())));
+}
+
+template<class Key, class Value, class Monoid>
+void AugmentedAVLTree<Key, Value, Monoid>::refreshPath(AVLNode<Key, Value>* node)
+{
+    while(node != NULL){
+        refreshNode(node);
+        node = node->getParent();
+    }
+}
+
+template<class Key, class Value, class Monoid>
+size_t AugmentedAVLTree<Key, Value, Monoid>::nodeSize() const
+{
+    return sizeof(AugNode);
+}
+
+template<class Key, class Value, class Monoid>
+Node<Key, Value>* AugmentedAVLTree<Key, Value, Monoid>::relocateNode(Node<Key, Value>* node, NodeArena& arena)
+{
+    return arena.copy(*static_cast<AugNode*>(node));
+}
+
+/**
+* The aggregates belong to the places in the tree, like the balances, so
+* they swap with the nodes; the remove that swapped them then refreshes
+* the path.
+*/
+template<class Key, class Value, class Monoid>
+void AugmentedAVLTree<Key, Value, Monoid>::nodeSwap(AVLNode<Key, Value>* n1, AVLNode<Key, Value>* n2)
+{
+    AVLTree<Key, Value>::nodeSwap(n1, n2);
+    AugNode* a1 = static_cast<AugNode*>(n1);
+    AugNode* a2 = static_cast<AugNode*>(n2);
+    Aggregate temp = a1->getAggregate();
+    a1->setAggregate(a2->getAggregate());
+    a2->setAggregate(temp);
+}
+
+/**
+* Aggregate of the whole tree.
+*/
+template<class Key, class Value, class Monoid>
+typename AugmentedAVLTree<Key, Value, Monoid>::Aggregate AugmentedAVLTree<Key, Value, Monoid>::aggregate() const
+{
+    return aggregateOf(static_cast<AugNode*>(this->root_));
+}
+
+/**
+* Aggregate of the items with lo <= key <= hi, in key order. O(log n):
+* below the node where the searches for lo and hi part ways, each step
+* down either path adds one node and one whole subtree.
+*/
+template<class Key, class Value, class Monoid>
+typename AugmentedAVLTree<Key, Value, Monoid>::Aggregate
+AugmentedAVLTree<Key, Value, Monoid>::rangeAggregate(const Key& lo, const Key& hi) const
+{
+    AugNode* split = static_cast<AugNode*>(this->root_);
+    while(split != NULL){
+        if(split->getKey() < lo){
+            split = split->getRight();
+        }
+        else if(hi < split->getKey()){
+            split = split->getLeft();
+        }
+        else{
+            break;
+        }
+    }
+    if(split == NULL){
+        return monoid_.identity();
+    }
+
+    // items >= lo in the left subtree, collected from the inside out
+    Aggregate leftPart = monoid_.identity();
+    for(AugNode* current = split->getLeft(); current != NULL; ){
+        if(current->getKey() < lo){
+            current = current->getRight();
+        }
+        else{
+            leftPart = monoid_.combine(monoid_.combine(monoid_.lift(current->getKey(), current->getValue()),
+                                                       aggregateOf(current->getRight())), leftPart);
+            current = current->getLeft();
+        }
+    }
+
+    // items <= hi in the right subtree
+    Aggregate rightPart = monoid_.identity();
+    for(AugNode* current = split->getRight(); current != NULL; ){
+        if(hi < current->getKey()){
+            current = current->getLeft();
+        }
+        else{
+            rightPart = monoid_.combine(rightPart, monoid_.combine(aggregateOf(current->getLeft()),
+                                                                   monoid_.lift(current->getKey(), current->getValue())));
+            current = current->getRight();
+        }
+    }
+
+    return monoid_.combine(monoid_.combine(leftPart, monoid_.lift(split->getKey(), split->getValue())), rightPart);
+}
+
+/**
+* Order statistics on the augmented tree: subtree sizes give the i-th
+* smallest key and the rank of a key in O(log n).
+*/
+template <class Key, class Value>
+class OrderStatisticTree : public AugmentedAVLTree<Key, Value, SubtreeSize<Key, Value> >
+{
+public:
+    typedef AugmentedAVLTree<Key, Value, SubtreeSize<Key, Value> > Base;
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    iterator select(size_t index) const;
+    size_t rank(const Key& key) const;
+};
+
+/**
+* The item with index keys smaller than it (0 is the smallest), or end().
+*/
+template<class Key, class Value>
+typename OrderStatisticTree<Key, Value>::iterator OrderStatisticTree<Key, Value>::select(size_t index) const
+{
+    iterator it;
+    it.tree_ = this;
+    typename Base::AugNode* current = static_cast<typename Base::AugNode*>(this->root_);
+    while(current != NULL){
+        size_t leftSize = this->aggregateOf(current->getLeft());
+        if(index < leftSize){
+            current = current->getLeft();
+        }
+        else if(index == leftSize){
+            it.current_ = current;
+            break;
+        }
+        else{
+            index -= leftSize + 1;
+            current = current->getRight();
+        }
+    }
+    return it;
+}
+
+/**
+* Number of keys smaller than key, whether or not key is present.
+*/
+template<class Key, class Value>
+size_t OrderStatisticTree<Key, Value>::rank(const Key& key) const
+{
+    size_t result = 0;
+    typename Base::AugNode* current = static_cast<typename Base::AugNode*>(this->root_);
+    while(current != NULL){
+        if(current->getKey() < key){
+            result += this->aggregateOf(current->getLeft()) + 1;
+            current = current->getRight();
+        }
+        else{
+            current = current->getLeft();
+        }
+    }
+    return result;
+}
+
+#endif
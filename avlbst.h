@@ -6,11 +6,16 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <vector>
+#include <future>
 #include "bst.h"
 #include "print_bst.h"
 
 struct KeyError { };
 
+// batches smaller than this are never split across threads
+#define AVL_BATCH_PARALLEL_GRAIN 4096
+
 /**
 * A special kind of node for an AVL tree, which adds the balance as a data member, plus
 * other additional helper functions. You do NOT need to implement any functionality or
@@ -133,283 +138,900 @@ template <class Key, class Value>
 class AVLTree : public BinarySearchTree<Key, Value>
 {
 public:
-    virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
     virtual void remove(const Key& key);  // TODO
-    bool leftHeavy(AVLNode<Key, Value>* root); // Done //
-    bool rightHeavy(AVLNode<Key, Value>* root); // Done //
-    bool leftLeft(AVLNode<Key, Value>* root); // Done //
-    bool leftRight(AVLNode<Key, Value>* root); // Done //
-    bool rightRight(AVLNode<Key, Value>* root); // Done //
-    bool rightLeft(AVLNode<Key,Value>* root); // Done //
-    void rotateLeft(AVLNode<Key, Value>* n1, AVLNode<Key,Value>*n2); //  Done //
-    void rotateRight(AVLNode<Key, Value>* n1, AVLNode<Key,Value>*n2); // DONE  //
-    int calculateBalance(AVLNode<Key, Value>* root); // DONE! //
-    void update(AVLNode<Key, Value>*current); // Done //
-    void performBalance(AVLNode<Key, Value>* root); // Done //
-    void updateTree(AVLNode<Key, Value>* root);
-    void updateRoot(AVLNode<Key,Value>* current);
-    int whatBalance(AVLNode<Key, Value>* root);
+    using BinarySearchTree<Key, Value>::remove;
+
+    // Batched updates. The input must be sorted by key; it is sorted
+    // (stably) first if it is not.
+    virtual void insertBatch(const std::vector<std::pair<Key, Value> >& items, unsigned int threads = 1);
+    virtual void removeBatch(const std::vector<Key>& keys, unsigned int threads = 1);
+
+    // Bulk load from pairs in any order. Sorts and builds on the pool; if a
+    // key is repeated the last pair wins, as with insert.
+    virtual void buildFromUnsorted(std::vector<std::pair<Key, Value> > items,
+                           WorkStealingPool& pool = WorkStealingPool::shared());
+
+    virtual void rebalance();
 
 protected:
+    virtual Node<Key, Value>* insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item);
     virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
 
-    // Add helper functions here
+    // Augmentation hooks (see augmentedavl.h). Every node is made by
+    // createNode; refreshNode is called on a node whose children or item
+    // changed, after its children are up to date, and refreshPath on a node
+    // and all its ancestors after an insert or remove below them. They do
+    // nothing here.
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value);
+    virtual void refreshNode(AVLNode<Key, Value>* node);
+    virtual void refreshPath(AVLNode<Key, Value>* node);
 
+    virtual size_t nodeSize() const;
+    virtual Node<Key, Value>* relocateNode(Node<Key, Value>* node, NodeArena& arena);
+
+    // Add helper functions here
+    int subtreeHeight(AVLNode<Key, Value>* root) const;
+    static void childHeights(AVLNode<Key, Value>* root, int height, int& left, int& right);
+    AVLNode<Key, Value>* linkNodes(AVLNode<Key, Value>* left, AVLNode<Key, Value>* mid, AVLNode<Key, Value>* right, int balance);
+    AVLNode<Key, Value>* rotateLeftAt(AVLNode<Key, Value>* n1);
+    AVLNode<Key, Value>* rotateRightAt(AVLNode<Key, Value>* n1);
+    AVLNode<Key, Value>* rebalanceAt(AVLNode<Key, Value>* n1);
+    int restoreBalances(AVLNode<Key, Value>* root);
+    void retraceInsert(AVLNode<Key, Value>* child);
+    void removeNode(AVLNode<Key, Value>* current);
+    void retraceRemove(AVLNode<Key, Value>* parent, bool fromLeft);
+    AVLNode<Key, Value>* joinTrees(AVLNode<Key, Value>* left, AVLNode<Key, Value>* mid, AVLNode<Key, Value>* right);
+    AVLNode<Key, Value>* joinTrees(AVLNode<Key, Value>* left, AVLNode<Key, Value>* right);
+    // The same joins for callers that already know the input heights; they
+    // report the height of the result, so a recursion can pass heights
+    // along instead of reading them off the tree each time.
+    AVLNode<Key, Value>* joinTrees(AVLNode<Key, Value>* left, int hl, AVLNode<Key, Value>* mid, AVLNode<Key, Value>* right, int hr, int& height);
+    AVLNode<Key, Value>* joinTrees(AVLNode<Key, Value>* left, int hl, AVLNode<Key, Value>* right, int hr, int& height);
+    AVLNode<Key, Value>* joinRight(AVLNode<Key, Value>* left, int hl, AVLNode<Key, Value>* mid, AVLNode<Key, Value>* right, int hr, int& height);
+    AVLNode<Key, Value>* joinLeft(AVLNode<Key, Value>* left, int hl, AVLNode<Key, Value>* mid, AVLNode<Key, Value>* right, int hr, int& height);
+    AVLNode<Key, Value>* splitLast(AVLNode<Key, Value>* root, int height, AVLNode<Key, Value>*& last, int& restHeight);
+    AVLNode<Key, Value>* detachLeft(AVLNode<Key, Value>* root);
+    AVLNode<Key, Value>* detachRight(AVLNode<Key, Value>* root);
+    AVLNode<Key, Value>* buildBalanced(const std::pair<Key, Value>* first, const std::pair<Key, Value>* last, int& height);
+    AVLNode<Key, Value>* batchUnion(AVLNode<Key, Value>* root, const std::pair<Key, Value>* first, const std::pair<Key, Value>* last, unsigned int threads, size_t& added);
+    AVLNode<Key, Value>* batchDifference(AVLNode<Key, Value>* root, const Key* first, const Key* last, unsigned int threads, size_t& removed);
+    static void dropDuplicates(std::vector<std::pair<Key, Value> >& sorted);
+    static void parallelSort(std::vector<std::pair<Key, Value> >& items, WorkStealingPool& pool);
+    void planBuild(const std::pair<Key, Value>* first, const std::pair<Key, Value>* last, int depth,
+                   std::vector<std::pair<const std::pair<Key, Value>*, const std::pair<Key, Value>*> >& pieces);
+    AVLNode<Key, Value>* stitchBuild(const std::pair<Key, Value>* first, const std::pair<Key, Value>* last, int depth,
+                                     const std::vector<AVLNode<Key, Value>*>& roots, const std::vector<int>& heights,
+                                     size_t& next, int& height);
 };
 
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ */
 template<class Key, class Value>
-int AVLTree<Key, Value>::whatBalance(AVLNode<Key, Value> *root) {
-    return root->getBalance();
-}
+Node<Key, Value>* AVLTree<Key, Value>::insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item)
+{
+    Node<Key, Value>* parent;
+    Node<Key, Value>* existing = this->findInsertPoint(start, new_item.first, parent);
+    if(existing != NULL){
+        existing->setValue(new_item.second);
+        refreshPath(static_cast<AVLNode<Key, Value>*>(existing));
+        return existing;
+    }
 
+    AVLNode<Key, Value> *addition = createNode(new_item.first, new_item.second);
+    this->attachLeaf(parent, addition);
+    retraceInsert(addition);
+    refreshPath(addition);
+    return addition;
+}
 
+/*
+ * Recall: The writeup specifies that if a node has 2 children you
+ * should swap with the predecessor and then remove.
+ */
 template<class Key, class Value>
-void AVLTree<Key, Value>::updateTree(AVLNode<Key, Value>* root) {
-    if(root == NULL){
-        return;
+void AVLTree<Key, Value>:: remove(const Key& key)
+{
+    AVLNode<Key, Value>* current = static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
+    if(current != NULL){
+        removeNode(current);
     }
-    updateTree(root->getLeft());
-    updateTree(root->getRight());
-    update(root);
-    if(abs(root->getBalance()) > 1){
-        performBalance(root);
+}
+
+/**
+* Unlinks and frees a node of this tree, then rebalances above it.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::removeNode(AVLNode<Key, Value>* current)
+{
+    if(this->twoChild(current)){
+        nodeSwap(current, static_cast<AVLNode<Key, Value>*>(this->predecessor(current)));
     }
+    this->trackRemoval(current);
+
+    AVLNode<Key, Value>* parent = current->getParent();
+    AVLNode<Key, Value>* child = (current->getLeft() != NULL) ? current->getLeft() : current->getRight();
+    bool fromLeft = (parent != NULL && parent->getLeft() == current);
+    this->replaceChild(parent, current, child);
+    delete current;
+    this->manyNodes--;
+
+    retraceRemove(parent, fromLeft);
+    refreshPath(parent);
 }
 
+/**
+* Fixes a node whose balance reached +-2 with a single or double rotation
+* and hangs the result where the node was. Returns the new subtree root.
+*/
 template<class Key, class Value>
-void AVLTree<Key, Value>::performBalance(AVLNode<Key, Value> *root) {
-    if(root == NULL){
-        return;
+AVLNode<Key, Value>* AVLTree<Key, Value>::rebalanceAt(AVLNode<Key, Value>* n1)
+{
+    AVLNode<Key, Value>* parent = n1->getParent();
+    AVLNode<Key, Value>* top;
+
+    if(n1->getBalance() > 0){
+        if(n1->getRight()->getBalance() < 0){
+            n1->setRight(rotateRightAt(n1->getRight()));
+            n1->getRight()->setParent(n1);
+            this->rotations_++;
+        }
+        top = rotateLeftAt(n1);
     }
-    if(leftHeavy(root)){
+    else{
+        if(n1->getLeft()->getBalance() > 0){
+            n1->setLeft(rotateLeftAt(n1->getLeft()));
+            n1->getLeft()->setParent(n1);
+            this->rotations_++;
+        }
+        top = rotateRightAt(n1);
+    }
+    this->rotations_++;
+    this->replaceChild(parent, n1, top);
+    return top;
+}
 
-        if(leftRight(root)){
-            rotateLeft(root->getLeft(), root->getLeft()->getRight());
-            rotateRight(root, root->getLeft());
-            //performBalance(root);
+/**
+* Walks up from a freshly attached leaf adjusting balances, and stops as
+* soon as a subtree keeps its height; at most one (double) rotation.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::retraceInsert(AVLNode<Key, Value>* child)
+{
+    AVLNode<Key, Value>* parent = child->getParent();
+    while(parent != NULL){
+        parent->updateBalance((parent->getLeft() == child) ? -1 : 1);
+        if(parent->getBalance() == 0){
+            return;
         }
+        if(abs(parent->getBalance()) > 1){
+            rebalanceAt(parent);
+            return;
+        }
+        child = parent;
+        parent = parent->getParent();
+    }
+}
 
-        if(leftLeft(root)){
-            rotateRight(root, root->getLeft());
+/**
+* Walks up from the parent of an unlinked node; fromLeft says which of its
+* subtrees got shorter. Stops once a subtree keeps its height.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::retraceRemove(AVLNode<Key, Value>* parent, bool fromLeft)
+{
+    while(parent != NULL){
+        parent->updateBalance(fromLeft ? 1 : -1);
+        if(abs(parent->getBalance()) == 1){
+            return;
+        }
+        AVLNode<Key, Value>* top = parent;
+        if(parent->getBalance() != 0){
+            AVLNode<Key, Value>* sibling = (parent->getBalance() > 0) ? parent->getRight() : parent->getLeft();
+            int8_t siblingBalance = sibling->getBalance();
+            top = rebalanceAt(parent);
+            if(siblingBalance == 0){
+                return;
+            }
+        }
+        parent = top->getParent();
+        if(parent != NULL){
+            fromLeft = (parent->getLeft() == top);
         }
     }
+}
 
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::createNode(const Key& key, const Value& value)
+{
+    return new AVLNode<Key, Value>(key, value, NULL);
+}
 
-    else if(rightHeavy(root)){
+template<class Key, class Value>
+void AVLTree<Key, Value>::refreshNode(AVLNode<Key, Value>* node)
+{
 
-        if(rightLeft(root)){
-            rotateRight(root->getRight(), root->getRight()->getLeft());
-            //performBalance(root);
-            rotateLeft(root, root->getRight());
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::refreshPath(AVLNode<Key, Value>* node)
+{
 
-        }
-        if(rightRight(root)){
-            rotateLeft(root, root->getRight());
-        }
-    }
-    return;
 }
 
 template<class Key, class Value>
-void AVLTree<Key, Value>::update(AVLNode<Key, Value> *current) {
-    current->setBalance(calculateBalance(current));
+size_t AVLTree<Key, Value>::nodeSize() const
+{
+    return sizeof(AVLNode<Key, Value>);
 }
 
 template<class Key, class Value>
-bool AVLTree<Key, Value>::leftHeavy(AVLNode<Key, Value> *root) {
-    if(root == NULL){
-        return false;
-    }
-    if(calculateBalance(root) < -1){
-        return true;
-    }
-    else{
-        return false;
-    }
+Node<Key, Value>* AVLTree<Key, Value>::relocateNode(Node<Key, Value>* node, NodeArena& arena)
+{
+    return arena.copy(*static_cast<AVLNode<Key, Value>*>(node));
 }
 
 template<class Key, class Value>
-bool AVLTree<Key, Value>::rightHeavy(AVLNode<Key, Value> *root) {
+void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+{
+    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    int8_t tempB = n1->getBalance();
+    n1->setBalance(n2->getBalance());
+    n2->setBalance(tempB);
+}
+
+/**
+* DSW relinks the nodes without looking at the balance factors, so they
+* (and whatever refreshNode keeps) are recomputed afterwards, bottom-up.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::rebalance()
+{
+    BinarySearchTree<Key, Value>::rebalance();
+    restoreBalances(static_cast<AVLNode<Key, Value>*>(this->root_));
+}
+
+/**
+* Sets every balance below root from the subtree heights and returns the
+* height. Recursive, but only run on the complete tree DSW leaves.
+*/
+template<class Key, class Value>
+int AVLTree<Key, Value>::restoreBalances(AVLNode<Key, Value>* root)
+{
     if(root == NULL){
-        return false;
-    }
-    if(calculateBalance(root) > 1){
-        return true;
+        return 0;
     }
-    else{
-        return false;
+    int left = restoreBalances(root->getLeft());
+    int right = restoreBalances(root->getRight());
+    root->setBalance(right - left);
+    refreshNode(root);
+    return std::max(left, right) + 1;
+}
+
+
+/*
+  -------------------------------------------------
+  Batched insert / remove.
+
+  Both operations walk the tree and the sorted batch together: the batch
+  is cut at the key of each visited node, each half is merged into the
+  matching subtree (on another thread when the halves are big enough),
+  and the results are glued back with an AVL join. A join only rotates
+  near the seam, so each affected subtree is rebalanced once per batch
+  instead of once per key.
+  -------------------------------------------------
+*/
+
+/**
+* Height of a subtree (0 when empty) read off the balance factors,
+* following the taller side down. O(log n).
+*/
+template<class Key, class Value>
+int AVLTree<Key, Value>::subtreeHeight(AVLNode<Key, Value>* root) const
+{
+    int height = 0;
+    while(root != NULL){
+        height++;
+        root = (root->getBalance() < 0) ? root->getLeft() : root->getRight();
     }
+    return height;
 }
 
+/**
+* Heights of root's children, from root's height and balance.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::childHeights(AVLNode<Key, Value>* root, int height, int& left, int& right)
+{
+    int balance = root->getBalance();
+    left = height - 1 - std::max(balance, 0);
+    right = height - 1 + std::min(balance, 0);
+}
 
+/**
+* Makes left and right the children of mid and stores the given balance.
+*/
 template<class Key, class Value>
-bool AVLTree<Key, Value>::leftLeft(AVLNode<Key, Value> *root) {
-    if(root == NULL){
-        return false;
+AVLNode<Key, Value>* AVLTree<Key, Value>::linkNodes(AVLNode<Key, Value>* left, AVLNode<Key, Value>* mid, AVLNode<Key, Value>* right, int balance)
+{
+    mid->setLeft(left);
+    mid->setRight(right);
+    if(left != NULL){
+        left->setParent(mid);
     }
-    if(leftHeavy(root)  && root->getLeft()->getLeft()!=NULL){
-        return true;
+    if(right != NULL){
+        right->setParent(mid);
     }
-    else{
-        return false;
+    mid->setBalance(balance);
+    refreshNode(mid);
+    return mid;
+}
+
+/**
+* Rotates n1 down to the left and returns the new subtree root. The
+* balances are derived from the old ones in O(1), so they must be exact
+* beforehand. The new root's parent is left to the caller.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::rotateLeftAt(AVLNode<Key, Value>* n1)
+{
+    AVLNode<Key, Value>* n2 = n1->getRight();
+    int b1 = n1->getBalance();
+    int b2 = n2->getBalance();
+
+    n1->setRight(n2->getLeft());
+    if(n1->getRight() != NULL){
+        n1->getRight()->setParent(n1);
     }
+    n2->setLeft(n1);
+    n1->setParent(n2);
+
+    b1 = b1 - 1 - std::max(b2, 0);
+    b2 = b2 - 1 + std::min(b1, 0);
+    n1->setBalance(b1);
+    n2->setBalance(b2);
+    refreshNode(n1);
+    refreshNode(n2);
+    return n2;
 }
 
+/**
+* Mirror image of rotateLeftAt.
+*/
 template<class Key, class Value>
-bool AVLTree<Key, Value>::leftRight(AVLNode<Key, Value> *root) {
-    if(root == NULL){
-        return false;
+AVLNode<Key, Value>* AVLTree<Key, Value>::rotateRightAt(AVLNode<Key, Value>* n1)
+{
+    AVLNode<Key, Value>* n2 = n1->getLeft();
+    int b1 = n1->getBalance();
+    int b2 = n2->getBalance();
+
+    n1->setLeft(n2->getRight());
+    if(n1->getLeft() != NULL){
+        n1->getLeft()->setParent(n1);
+    }
+    n2->setRight(n1);
+    n1->setParent(n2);
+
+    b1 = b1 + 1 - std::min(b2, 0);
+    b2 = b2 + 1 + std::max(b1, 0);
+    n1->setBalance(b1);
+    n2->setBalance(b2);
+    refreshNode(n1);
+    refreshNode(n2);
+    return n2;
+}
+
+/**
+* Joins two detached AVL subtrees around mid, where every key in left is
+* smaller than mid's and every key in right is larger. Returns the new
+* root, whose parent is set to NULL.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::joinTrees(AVLNode<Key, Value>* left, AVLNode<Key, Value>* mid, AVLNode<Key, Value>* right)
+{
+    int height;
+    return joinTrees(left, subtreeHeight(left), mid, right, subtreeHeight(right), height);
+}
+
+/**
+* Joins two detached subtrees with no middle node, every key in left
+* being smaller than every key in right.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::joinTrees(AVLNode<Key, Value>* left, AVLNode<Key, Value>* right)
+{
+    int height;
+    return joinTrees(left, subtreeHeight(left), right, subtreeHeight(right), height);
+}
+
+/**
+* joinTrees around mid given hl and hr, the heights of left and right.
+* O(|hl - hr| + 1).
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::joinTrees(AVLNode<Key, Value>* left, int hl, AVLNode<Key, Value>* mid, AVLNode<Key, Value>* right, int hr, int& height)
+{
+    AVLNode<Key, Value>* result;
+    if(hl > hr + 1){
+        result = joinRight(left, hl, mid, right, hr, height);
     }
-    if(leftHeavy(root) && root->getLeft()->getRight()!=NULL){
-        return true;
+    else if(hr > hl + 1){
+        result = joinLeft(left, hl, mid, right, hr, height);
     }
     else{
-        return false;
+        result = linkNodes(left, mid, right, hr - hl);
+        height = std::max(hl, hr) + 1;
     }
+    result->setParent(NULL);
+    return result;
 }
 
+/**
+* Join for a left tree that is more than one level taller: walks down the
+* right spine of left until the heights match, hangs mid there, and fixes
+* the one spot that can end up out of balance on the way back up.
+*/
 template<class Key, class Value>
-bool AVLTree<Key, Value>::rightRight(AVLNode<Key, Value> *root) {
-    if(root == NULL){
-        return false;
-    }
-    if(rightHeavy(root) && root->getRight()->getRight()!=NULL){
-        return true;
+AVLNode<Key, Value>* AVLTree<Key, Value>::joinRight(AVLNode<Key, Value>* left, int hl, AVLNode<Key, Value>* mid, AVLNode<Key, Value>* right, int hr, int& height)
+{
+    AVLNode<Key, Value>* c = left->getRight();
+    int hll, hc;
+    childHeights(left, hl, hll, hc);
+
+    AVLNode<Key, Value>* t;
+    int ht;
+    if(hc <= hr + 1){
+        t = linkNodes(c, mid, right, hr - hc);
+        ht = std::max(hc, hr) + 1;
     }
     else{
-        return false;
+        t = joinRight(c, hc, mid, right, hr, ht);
     }
+
+    linkNodes(left->getLeft(), left, t, ht - hll);
+    if(left->getBalance() <= 1){
+        height = std::max(hll, ht) + 1;
+        return left;
+    }
+    // ht is hll + 2 here; only a single rotation over an even t grows it
+    height = (t->getBalance() == 0) ? ht + 1 : ht;
+    if(t->getBalance() < 0){
+        left->setRight(rotateRightAt(t));
+        left->getRight()->setParent(left);
+    }
+    return rotateLeftAt(left);
 }
 
+/**
+* Mirror image of joinRight.
+*/
 template<class Key, class Value>
-bool AVLTree<Key, Value>::rightLeft(AVLNode<Key, Value> *root) {
-    if(root == NULL){
-        return false;
-    }
-    if(rightHeavy(root) && root->getRight()->getLeft()!=NULL){
-        return true;
+AVLNode<Key, Value>* AVLTree<Key, Value>::joinLeft(AVLNode<Key, Value>* left, int hl, AVLNode<Key, Value>* mid, AVLNode<Key, Value>* right, int hr, int& height)
+{
+    AVLNode<Key, Value>* c = right->getLeft();
+    int hc, hrr;
+    childHeights(right, hr, hc, hrr);
+
+    AVLNode<Key, Value>* t;
+    int ht;
+    if(hc <= hl + 1){
+        t = linkNodes(left, mid, c, hc - hl);
+        ht = std::max(hc, hl) + 1;
     }
     else{
-        return false;
+        t = joinLeft(left, hl, mid, c, hc, ht);
+    }
+
+    linkNodes(t, right, right->getRight(), hrr - ht);
+    if(right->getBalance() >= -1){
+        height = std::max(hrr, ht) + 1;
+        return right;
     }
+    height = (t->getBalance() == 0) ? ht + 1 : ht;
+    if(t->getBalance() > 0){
+        right->setLeft(rotateLeftAt(t));
+        right->getLeft()->setParent(right);
+    }
+    return rotateRightAt(right);
 }
 
+/**
+* joinTrees with no middle node, given the heights. The last node of left
+* is split off to serve as the middle one.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::joinTrees(AVLNode<Key, Value>* left, int hl, AVLNode<Key, Value>* right, int hr, int& height)
+{
+    if(left == NULL){
+        height = hr;
+        return right;
+    }
+    AVLNode<Key, Value>* last = NULL;
+    int restHeight;
+    AVLNode<Key, Value>* rest = splitLast(left, hl, last, restHeight);
+    return joinTrees(rest, restHeight, last, right, hr, height);
+}
 
+/**
+* Unlinks the largest node of a detached subtree of the given height into
+* last and returns what is left, rebalanced, with its height in
+* restHeight. The joins on the way up cost O(log n) together.
+*/
 template<class Key, class Value>
-int AVLTree<Key, Value>::calculateBalance(AVLNode<Key, Value>* root){
-    return (this->getHeight(root->getRight()) - this->getHeight(root->getLeft()));
+AVLNode<Key, Value>* AVLTree<Key, Value>::splitLast(AVLNode<Key, Value>* root, int height, AVLNode<Key, Value>*& last, int& restHeight)
+{
+    int hl, hr;
+    childHeights(root, height, hl, hr);
+    AVLNode<Key, Value>* left = detachLeft(root);
+    if(root->getRight() == NULL){
+        last = root;
+        root->setParent(NULL);
+        restHeight = hl;
+        return left;
+    }
+    int hrest;
+    AVLNode<Key, Value>* right = splitLast(detachRight(root), hr, last, hrest);
+    return joinTrees(left, hl, root, right, hrest, restHeight);
 }
 
 template<class Key, class Value>
-void AVLTree<Key, Value>::updateRoot(AVLNode<Key,Value>* current){
-    this->root_ = static_cast<Node<Key,Value>*>(current);
+AVLNode<Key, Value>* AVLTree<Key, Value>::detachLeft(AVLNode<Key, Value>* root)
+{
+    AVLNode<Key, Value>* child = root->getLeft();
+    root->setLeft(NULL);
+    if(child != NULL){
+        child->setParent(NULL);
+    }
+    return child;
 }
 
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::detachRight(AVLNode<Key, Value>* root)
+{
+    AVLNode<Key, Value>* child = root->getRight();
+    root->setRight(NULL);
+    if(child != NULL){
+        child->setParent(NULL);
+    }
+    return child;
+}
 
+/**
+* Builds a perfectly balanced subtree out of a sorted, duplicate free range.
+*/
 template<class Key, class Value>
-void AVLTree<Key, Value>::rotateRight(AVLNode<Key, Value> *n1, AVLNode<Key, Value> *n2) {
+AVLNode<Key, Value>* AVLTree<Key, Value>::buildBalanced(const std::pair<Key, Value>* first, const std::pair<Key, Value>* last, int& height)
+{
+    if(first == last){
+        height = 0;
+        return NULL;
+    }
+    const std::pair<Key, Value>* mid = first + (last - first) / 2;
+    int hl, hr;
+    AVLNode<Key, Value>* left = buildBalanced(first, mid, hl);
+    AVLNode<Key, Value>* right = buildBalanced(mid + 1, last, hr);
+    AVLNode<Key, Value>* root = createNode(mid->first, mid->second);
+    height = std::max(hl, hr) + 1;
+    return linkNodes(left, root, right, hr - hl);
+}
 
-    if(n1 == this->root_){
-        updateRoot(n2);
+/**
+* Merges a sorted, duplicate free range into the detached subtree at root.
+* Keys already present get their value overwritten, like insert.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::batchUnion(AVLNode<Key, Value>* root, const std::pair<Key, Value>* first, const std::pair<Key, Value>* last, unsigned int threads, size_t& added)
+{
+    if(first == last){
+        return root;
     }
-    n2->setParent(n1->getParent());
-    n1->setLeft(n2->getRight());
-    if(n1->getLeft()!= NULL){
-        n1->getLeft()->setParent(n1);
+    if(root == NULL){
+        int height;
+        added += last - first;
+        AVLNode<Key, Value>* built = buildBalanced(first, last, height);
+        built->setParent(NULL);
+        return built;
     }
-    n2->setRight(n1);
 
-    if(n1->getParent()!= NULL) {
-        if (this->isLeftChild(n1)) {
-            n1->getParent()->setLeft(n2);
-        } else if (this->isRightChild(n1)) {
-            n1->getParent()->setRight(n2);
+    const Key& key = root->getKey();
+    const std::pair<Key, Value>* lo = first;
+    size_t count = last - first;
+    while(count > 0){
+        size_t step = count / 2;
+        if(lo[step].first < key){
+            lo += step + 1;
+            count -= step + 1;
         }
+        else{
+            count = step;
+        }
+    }
+    const std::pair<Key, Value>* hi = lo;
+    if(hi != last && !(key < hi->first)){
+        root->setValue(hi->second);
+        ++hi;
     }
 
-    n1->setParent(n2);
-    update(n1);
-    update(n2);
+    AVLNode<Key, Value>* left = detachLeft(root);
+    AVLNode<Key, Value>* right = detachRight(root);
 
+    size_t addedRight = 0;
+    if(threads > 1 && (size_t)(last - first) >= AVL_BATCH_PARALLEL_GRAIN){
+        std::future<AVLNode<Key, Value>*> leftDone = std::async(std::launch::async,
+                &AVLTree<Key, Value>::batchUnion, this, left, first, lo, threads / 2, std::ref(added));
+        right = batchUnion(right, hi, last, threads - threads / 2, addedRight);
+        left = leftDone.get();
+    }
+    else{
+        left = batchUnion(left, first, lo, 1, added);
+        right = batchUnion(right, hi, last, 1, addedRight);
+    }
+    added += addedRight;
+    return joinTrees(left, root, right);
 }
+
+/**
+* Removes every key of a sorted range from the detached subtree at root.
+*/
 template<class Key, class Value>
-void AVLTree<Key, Value>::rotateLeft(AVLNode<Key, Value> *n1, AVLNode<Key, Value> *n2) {
-    if(n1 == this->root_){
-        updateRoot(n2);
-    }
-    n2->setParent(n1->getParent());
-    n1->setRight(n2->getLeft());
-    if(n1->getRight()!= NULL){
-        n1->getRight()->setParent(n1);
+AVLNode<Key, Value>* AVLTree<Key, Value>::batchDifference(AVLNode<Key, Value>* root, const Key* first, const Key* last, unsigned int threads, size_t& removed)
+{
+    if(root == NULL || first == last){
+        return root;
     }
-    n2->setLeft(n1);
-    if(n1->getParent()!= NULL) {
-        if (this->isLeftChild(n1)) {
-            n1->getParent()->setLeft(n2);
-        } else if (this->isRightChild(n1)) {
-            n1->getParent()->setRight(n2);
-        }
+
+    const Key* lo = std::lower_bound(first, last, root->getKey());
+    const Key* hi = lo;
+    while(hi != last && !(root->getKey() < *hi)){
+        ++hi;
     }
 
-    n1->setParent(n2);
-    update(n1);
-    update(n2);
+    AVLNode<Key, Value>* left = detachLeft(root);
+    AVLNode<Key, Value>* right = detachRight(root);
+
+    size_t removedRight = 0;
+    if(threads > 1 && (size_t)(last - first) >= AVL_BATCH_PARALLEL_GRAIN){
+        std::future<AVLNode<Key, Value>*> leftDone = std::async(std::launch::async,
+                &AVLTree<Key, Value>::batchDifference, this, left, first, lo, threads / 2, std::ref(removed));
+        right = batchDifference(right, hi, last, threads - threads / 2, removedRight);
+        left = leftDone.get();
+    }
+    else{
+        left = batchDifference(left, first, lo, 1, removed);
+        right = batchDifference(right, hi, last, 1, removedRight);
+    }
+    removed += removedRight;
 
+    if(lo != hi){
+        delete root;
+        removed++;
+        return joinTrees(left, right);
+    }
+    return joinTrees(left, root, right);
 }
-/*
- * Recall: If key is already in the tree, you should
- * overwrite the current value with the updated value.
- */
+
+/**
+* Inserts every pair of a batch sorted by key. If a key appears several
+* times the last occurrence wins, the same as calling insert in order.
+* With threads > 1, big batches are split across that many threads.
+*/
 template<class Key, class Value>
-void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+void AVLTree<Key, Value>::insertBatch(const std::vector<std::pair<Key, Value> >& items, unsigned int threads)
 {
-    if(this->empty()){
-        AVLNode<Key, Value> *addition = new AVLNode<Key, Value>(new_item.first, new_item.second, NULL);
-        this->root_ = addition;
-        this-> manyNodes++;
-
-        return;
+    std::vector<std::pair<Key, Value> > sorted;
+    const std::vector<std::pair<Key, Value> >* input = &items;
+
+    bool ordered = true;
+    bool unique = true;
+    for(size_t i = 1; i < items.size() && ordered; i++){
+        if(items[i].first < items[i - 1].first){
+            ordered = false;
+        }
+        else if(!(items[i - 1].first < items[i].first)){
+            unique = false;
+        }
     }
-
-    if(this->find(new_item.first) != this->end()){
-        this->find(new_item.first).current_->setValue(new_item.second);
+    if(!ordered || !unique){
+        sorted = items;
+        if(!ordered){
+            std::stable_sort(sorted.begin(), sorted.end(),
+                    [](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b){ return a.first < b.first; });
+        }
+        dropDuplicates(sorted);
+        input = &sorted;
+    }
+    if(input->empty()){
         return;
     }
 
+    size_t added = 0;
+    const std::pair<Key, Value>* first = &(*input)[0];
+    this->root_ = batchUnion(static_cast<AVLNode<Key, Value>*>(this->root_), first, first + input->size(),
+                             std::max(threads, 1u), added);
+    this->manyNodes += added;
+    this->refreshEnds();
+}
 
-    AVLNode<Key, Value> *addition = new AVLNode<Key, Value>(new_item.first, new_item.second, NULL);
-    BinarySearchTree<Key, Value>::recursiveInsert(this->root_, addition);
-
-    AVLNode<Key, Value>* temp = reinterpret_cast<AVLNode<Key, Value>*>(this->root_);
-    updateTree(temp);
+/**
+* Removes every key of a batch sorted in increasing order. Keys that are
+* not in the tree are ignored.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::removeBatch(const std::vector<Key>& keys, unsigned int threads)
+{
+    if(keys.empty() || this->empty()){
+        return;
+    }
 
+    std::vector<Key> sorted;
+    const std::vector<Key>* input = &keys;
+    for(size_t i = 1; i < keys.size(); i++){
+        if(keys[i] < keys[i - 1]){
+            sorted = keys;
+            std::sort(sorted.begin(), sorted.end());
+            input = &sorted;
+            break;
+        }
+    }
 
+    size_t removed = 0;
+    const Key* first = &(*input)[0];
+    this->root_ = batchDifference(static_cast<AVLNode<Key, Value>*>(this->root_), first, first + input->size(),
+                                  std::max(threads, 1u), removed);
+    this->manyNodes -= removed;
+    this->refreshEnds();
+}
 
 
+/**
+* Shrinks a vector sorted by key so each key appears once, keeping the
+* last pair of every run of equal keys.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::dropDuplicates(std::vector<std::pair<Key, Value> >& sorted)
+{
+    size_t out = 0;
+    for(size_t i = 0; i < sorted.size(); i++){
+        if(i + 1 < sorted.size() && !(sorted[i].first < sorted[i + 1].first)){
+            continue;
+        }
+        if(out != i){
+            sorted[out] = sorted[i];
+        }
+        out++;
+    }
+    sorted.resize(out);
 }
 
-/*
- * Recall: The writeup specifies that if a node has 2 children you
- * should swap with the predecessor and then remove.
- */
+/**
+* Stable sort by key: one chunk per thread is sorted on the pool, then
+* neighbouring runs are merged pairwise, also on the pool, until one is left.
+*/
 template<class Key, class Value>
-void AVLTree<Key, Value>:: remove(const Key& key)
+void AVLTree<Key, Value>::parallelSort(std::vector<std::pair<Key, Value> >& items, WorkStealingPool& pool)
 {
+    typedef typename std::vector<std::pair<Key, Value> >::iterator Iter;
+    auto byKey = [](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b){ return a.first < b.first; };
 
-    BinarySearchTree<Key, Value>::remove(key);
-    updateTree(static_cast<AVLNode<Key, Value>*>(this->root_));
+    size_t n = items.size();
+    size_t chunks = pool.size();
+    if(chunks < 2 || n < AVL_BATCH_PARALLEL_GRAIN){
+        std::stable_sort(items.begin(), items.end(), byKey);
+        return;
+    }
+    size_t width = (n + chunks - 1) / chunks;
 
+    std::vector<std::function<void()> > tasks;
+    for(size_t lo = 0; lo < n; lo += width){
+        Iter first = items.begin() + lo;
+        Iter last = items.begin() + std::min(lo + width, n);
+        tasks.push_back([first, last, byKey](){ std::stable_sort(first, last, byKey); });
+    }
+    pool.run(tasks);
+
+    for(; width < n; width *= 2){
+        tasks.clear();
+        for(size_t lo = 0; lo + width < n; lo += 2 * width){
+            Iter first = items.begin() + lo;
+            Iter mid = items.begin() + lo + width;
+            Iter last = items.begin() + std::min(lo + 2 * width, n);
+            tasks.push_back([first, mid, last, byKey](){ std::inplace_merge(first, mid, last, byKey); });
+        }
+        pool.run(tasks);
+    }
+}
 
+/**
+* Walks the top depth levels of the balanced shape of [first, last) and
+* records the ranges below them; each becomes one subtree built on the pool.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::planBuild(const std::pair<Key, Value>* first, const std::pair<Key, Value>* last, int depth,
+                                    std::vector<std::pair<const std::pair<Key, Value>*, const std::pair<Key, Value>*> >& pieces)
+{
+    if(depth == 0 || (size_t)(last - first) < AVL_BATCH_PARALLEL_GRAIN){
+        pieces.push_back(std::make_pair(first, last));
+        return;
+    }
+    const std::pair<Key, Value>* mid = first + (last - first) / 2;
+    planBuild(first, mid, depth - 1, pieces);
+    planBuild(mid + 1, last, depth - 1, pieces);
 }
 
+/**
+* Retraces planBuild, creating the top nodes and hanging the subtrees
+* built by the pool (taken in order from roots) beneath them.
+*/
 template<class Key, class Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+AVLNode<Key, Value>* AVLTree<Key, Value>::stitchBuild(const std::pair<Key, Value>* first, const std::pair<Key, Value>* last, int depth,
+                                                      const std::vector<AVLNode<Key, Value>*>& roots, const std::vector<int>& heights,
+                                                      size_t& next, int& height)
 {
-    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
-    int8_t tempB = n1->getBalance();
-    n1->setBalance(n2->getBalance());
-    n2->setBalance(tempB);
+    if(depth == 0 || (size_t)(last - first) < AVL_BATCH_PARALLEL_GRAIN){
+        height = heights[next];
+        return roots[next++];
+    }
+    const std::pair<Key, Value>* mid = first + (last - first) / 2;
+    int hl, hr;
+    AVLNode<Key, Value>* left = stitchBuild(first, mid, depth - 1, roots, heights, next, hl);
+    AVLNode<Key, Value>* right = stitchBuild(mid + 1, last, depth - 1, roots, heights, next, hr);
+    AVLNode<Key, Value>* root = createNode(mid->first, mid->second);
+    height = std::max(hl, hr) + 1;
+    return linkNodes(left, root, right, hr - hl);
 }
 
+/**
+* Loads a large unsorted set of pairs: parallel stable sort, drop all but
+* the last pair of each key, then build balanced subtrees concurrently and
+* link them under a few top nodes. Each subtree's nodes are allocated by
+* the worker thread that builds it, so they come from that thread's malloc
+* arena. If the tree already has items the result is merged into it with
+* the batch union.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::buildFromUnsorted(std::vector<std::pair<Key, Value> > items, WorkStealingPool& pool)
+{
+    parallelSort(items, pool);
+    dropDuplicates(items);
+    if(items.empty()){
+        return;
+    }
+
+    const std::pair<Key, Value>* first = &items[0];
+    const std::pair<Key, Value>* last = first + items.size();
+    if(!this->empty()){
+        size_t added = 0;
+        this->root_ = batchUnion(static_cast<AVLNode<Key, Value>*>(this->root_), first, last, pool.size(), added);
+        this->manyNodes += added;
+        this->refreshEnds();
+        return;
+    }
+
+    int depth = 0;
+    while((1u << depth) < 4 * pool.size() && depth < 20){
+        depth++;
+    }
+    std::vector<std::pair<const std::pair<Key, Value>*, const std::pair<Key, Value>*> > pieces;
+    planBuild(first, last, depth, pieces);
+
+    std::vector<AVLNode<Key, Value>*> roots(pieces.size(), NULL);
+    std::vector<int> heights(pieces.size(), 0);
+    std::vector<std::function<void()> > tasks;
+    for(size_t i = 0; i < pieces.size(); i++){
+        tasks.push_back([this, i, &pieces, &roots, &heights](){
+            roots[i] = buildBalanced(pieces[i].first, pieces[i].second, heights[i]);
+        });
+    }
+    pool.run(tasks);
+
+    size_t next = 0;
+    int height;
+    AVLNode<Key, Value>* root = stitchBuild(first, last, depth, roots, heights, next, height);
+    root->setParent(NULL);
+    this->root_ = root;
+    this->manyNodes = (int)items.size();
+    this->refreshEnds();
+}
 
 #endif
@@ -0,0 +1,469 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include "bst.h"
+#include "avlbst.h"
+#include "rbbst.h"
+#include "treapbst.h"
+#include "wavlbst.h"
+#include "splaybst.h"
+#include "scapegoatbst.h"
+#include "threadedavl.h"
+#include "lazyavl.h"
+
+using namespace std;
+
+// Benchmark driver for the balanced tree engines.
+// Usage: ./bst-bench [n]   (default n = 200000)
+
+typedef chrono::steady_clock Clock;
+
+double msSince(Clock::time_point start)
+{
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// Exposes the root so the benchmark can report the tree shape.
+template<class Tree>
+class Probe : public Tree
+{
+public:
+    double averageDepth() const
+    {
+        long total = 0;
+        long count = 0;
+        walk(this->root_, 1, total, count);
+        return count == 0 ? 0.0 : (double)total / count;
+    }
+
+    int height() const
+    {
+        return this->getHeight(this->root_) + 1;
+    }
+
+private:
+    void walk(Node<int, int>* node, long depth, long& total, long& count) const
+    {
+        if(node == NULL) {
+            return;
+        }
+        total += depth;
+        count++;
+        walk(node->getLeft(), depth + 1, total, count);
+        walk(node->getRight(), depth + 1, total, count);
+    }
+};
+
+struct Result
+{
+    double insertMs;
+    double sequentialMs;
+    double mixedMs;
+    double findMs;
+    double rotationsPerUpdate;
+    double averageDepth;
+    int height;
+};
+
+template<class Tree>
+Result runEngine(int n, unsigned seed)
+{
+    Result result;
+    mt19937 rng(seed);
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++) {
+        keys[i] = (int)(rng() % (2u * n));
+    }
+
+    // random inserts
+    Probe<Tree> tree;
+    Clock::time_point start = Clock::now();
+    for(int i = 0; i < n; i++) {
+        tree.insert(make_pair(keys[i], i));
+    }
+    result.insertMs = msSince(start);
+    result.averageDepth = tree.averageDepth();
+    result.height = tree.height();
+
+    // lookups, half of them misses
+    start = Clock::now();
+    long found = 0;
+    for(int i = 0; i < n; i++) {
+        if(tree.find(keys[i] ^ (i & 1)) != tree.end()) {
+            found++;
+        }
+    }
+    result.findMs = msSince(start);
+
+    // mixed: 60% find, 25% insert, 15% remove
+    unsigned long rotationsBefore = tree.rotationCount();
+    long updates = 0;
+    start = Clock::now();
+    for(int i = 0; i < n; i++) {
+        int key = (int)(rng() % (2u * n));
+        unsigned op = rng() % 100;
+        if(op < 60) {
+            if(tree.find(key) != tree.end()) {
+                found++;
+            }
+        }
+        else if(op < 85) {
+            tree.insert(make_pair(key, i));
+            updates++;
+        }
+        else {
+            tree.remove(key);
+            updates++;
+        }
+    }
+    result.mixedMs = msSince(start);
+    result.rotationsPerUpdate = (double)(tree.rotationCount() - rotationsBefore) / updates;
+
+    // ascending inserts, the worst case for an unbalanced tree
+    Tree sequential;
+    start = Clock::now();
+    for(int i = 0; i < n; i++) {
+        sequential.insert(make_pair(i, i));
+    }
+    result.sequentialMs = msSince(start);
+
+    if(found < 0) {
+        cout << found;
+    }
+    return result;
+}
+
+struct LayoutResult
+{
+    double iterateMs;
+    double findMs;
+    double megabytes;
+};
+
+// Times a full scan and n lookups of present keys.
+LayoutResult measureLayout(const AVLTree<int, int>& tree, const vector<int>& present)
+{
+    LayoutResult result;
+    long sum = 0;
+    Clock::time_point start = Clock::now();
+    for(int pass = 0; pass < 5; pass++) {
+        for(AVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it) {
+            sum += it->second;
+        }
+    }
+    result.iterateMs = msSince(start) / 5;
+
+    start = Clock::now();
+    for(size_t i = 0; i < present.size(); i++) {
+        sum += tree.find(present[i])->second;
+    }
+    result.findMs = msSince(start);
+    result.megabytes = tree.memoryUsage() / (1024.0 * 1024.0);
+
+    if(sum == 42) {
+        cout << sum;
+    }
+    return result;
+}
+
+void reportLayout(const string& name, const LayoutResult& r)
+{
+    cout << left << setw(10) << name << right << fixed << setprecision(1)
+         << setw(11) << r.iterateMs << setw(11) << r.findMs
+         << setprecision(2) << setw(11) << r.megabytes << endl;
+}
+
+template<class Tree>
+void churn(Tree& tree, int n)
+{
+    mt19937 rng(5);
+    for(int i = 0; i < 2 * n; i++) {
+        tree.insert(make_pair((int)(rng() % (4u * n)), i));
+    }
+    for(int i = 0; i < 2 * n; i++) {
+        tree.remove((int)(rng() % (4u * n)));
+    }
+}
+
+// AVL tree after a long run of inserts and removes, before and after
+// compact() in both layouts, and a threaded tree after the same run,
+// scattered and compacted.
+void runCompaction(int n)
+{
+    AVLTree<int, int> tree;
+    ThreadedAVLTree<int, int> threaded;
+    churn(tree, n);
+    churn(threaded, n);
+    mt19937 rng(5);
+
+    vector<int> present;
+    for(AVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it) {
+        present.push_back(it->first);
+    }
+    shuffle(present.begin(), present.end(), rng);
+
+    cout << endl << "compaction, " << tree.manyNodes << " keys left after "
+         << 2 * n << " inserts and removes" << endl;
+    cout << left << setw(10) << "layout" << right
+         << setw(11) << "iterate" << setw(11) << "find" << setw(11) << "MB" << endl;
+    reportLayout("heap", measureLayout(tree, present));
+    reportLayout("threaded", measureLayout(threaded, present));
+
+    // the same layout as compact(COMPACT_IN_ORDER), a bounded step at a time
+    vector<double> pauses;
+    bool done = false;
+    while(!done) {
+        Clock::time_point start = Clock::now();
+        done = tree.relocateStep(256);
+        pauses.push_back(msSince(start) * 1000);
+    }
+    reportLayout("stepwise", measureLayout(tree, present));
+    tree.compact(COMPACT_IN_ORDER);
+    reportLayout("in-order", measureLayout(tree, present));
+    tree.compact(COMPACT_VEB);
+    reportLayout("veb", measureLayout(tree, present));
+    threaded.compact(COMPACT_VEB);
+    reportLayout("thr-veb", measureLayout(threaded, present));
+    sort(pauses.begin(), pauses.end());
+    cout << "stepwise: " << pauses.size() << " steps of 256 nodes, median "
+         << setprecision(1) << pauses[pauses.size() / 2] << " us, 99th percentile "
+         << pauses[pauses.size() * 99 / 100] << " us, longest " << pauses.back() << " us" << endl;
+}
+
+// Full scans of a scattered AVL tree: the plain iterator, then scan() at
+// each prefetch distance, best of five runs. The fastest distance is the
+// one to build with (-DBST_SCAN_DISTANCE).
+void runScan(int n)
+{
+    AVLTree<int, int> tree;
+    churn(tree, n);
+
+    const size_t distances[] = { 0, 1, 2, 3, 4, 6, 8, 12, 16, 24 };
+    const int count = sizeof(distances) / sizeof(distances[0]);
+    vector<double> best(count + 1, 1e30);
+    long sum = 0;
+    for(int run = 0; run < 5; run++) {
+        Clock::time_point start = Clock::now();
+        for(AVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it) {
+            sum += it->second;
+        }
+        best[count] = min(best[count], msSince(start));
+        for(int i = 0; i < count; i++) {
+            start = Clock::now();
+            for(AVLTree<int, int>::scan_iterator it = tree.scan(distances[i]); it != tree.end(); ++it) {
+                sum += it->second;
+            }
+            best[i] = min(best[i], msSince(start));
+        }
+    }
+
+    cout << endl << "scan of " << tree.manyNodes << " scattered keys (ms)" << endl;
+    cout << left << setw(10) << "iterator" << right << fixed << setprecision(1) << setw(11) << best[count] << endl;
+    int fastest = 0;
+    for(int i = 0; i < count; i++) {
+        cout << left << setw(10) << ("scan " + to_string(distances[i])) << right << setw(11) << best[i] << endl;
+        if(best[i] < best[fastest]) {
+            fastest = i;
+        }
+    }
+    cout << "fastest distance: " << distances[fastest] << " (built with " << BST_SCAN_DISTANCE << ")" << endl;
+    if(sum == 42) {
+        cout << sum;
+    }
+}
+
+// Counts the bytes written to it and drops them.
+class CountingBuffer : public streambuf
+{
+public:
+    CountingBuffer() : bytes(0) { }
+
+    size_t bytes;
+
+protected:
+    streamsize xsputn(const char*, streamsize count)
+    {
+        bytes += (size_t)count;
+        return count;
+    }
+
+    int overflow(int c)
+    {
+        bytes++;
+        return c;
+    }
+};
+
+// exportTree in each format, and a small window of the same tree.
+void runExport(int n)
+{
+    AVLTree<int, int> tree;
+    for(int i = 0; i < n; i++) {
+        tree.insert(make_pair(i, i));
+    }
+
+    cout << endl << "export of " << n << " keys" << endl;
+    const char* names[] = { "dot", "json", "binary" };
+    for(int format = EXPORT_DOT; format <= EXPORT_BINARY; format++) {
+        CountingBuffer counter;
+        ostream out(&counter);
+        Clock::time_point start = Clock::now();
+        tree.exportTree(out, (ExportFormat)format);
+        cout << left << setw(10) << names[format] << right << fixed << setprecision(1)
+             << setw(11) << msSince(start) << " ms" << setprecision(2)
+             << setw(11) << counter.bytes / (1024.0 * 1024.0) << " MB" << endl;
+    }
+    CountingBuffer counter;
+    ostream out(&counter);
+    Clock::time_point start = Clock::now();
+    tree.exportTree(out, EXPORT_DOT, n / 2, n / 2 + 100, 30);
+    cout << left << setw(10) << "window" << right << setprecision(3)
+         << setw(11) << msSince(start) << " ms" << setw(11) << counter.bytes << " B" << endl;
+}
+
+void cleanUp(AVLTree<int, int>&, int)
+{
+}
+
+void cleanUp(LazyAVLTree<int, int>& tree, int mode)
+{
+    if(mode == 1) {
+        tree.purge();
+    }
+    else if(mode == 2) {
+        while(!tree.purgeStep(256)) {
+        }
+    }
+}
+
+// A burst of removes of half the keys in random order, then a find of
+// every key. The lazy trees only mark the nodes; their cleanup is timed
+// on its own: the automatic purges at the default ratio, or with them
+// off, one purge() or purgeStep(256) until a pass completes.
+template<class Tree>
+void runBurst(const string& name, Tree& tree, int n, int mode)
+{
+    mt19937 rng(5);
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++) {
+        keys[i] = i;
+    }
+    shuffle(keys.begin(), keys.end(), rng);
+    for(int i = 0; i < n; i++) {
+        tree.insert(make_pair(keys[i], i));
+    }
+    shuffle(keys.begin(), keys.end(), rng);
+
+    Clock::time_point start = Clock::now();
+    for(int i = 0; i < n / 2; i++) {
+        tree.remove(keys[i]);
+    }
+    double removeMs = msSince(start);
+    start = Clock::now();
+    cleanUp(tree, mode);
+    double cleanupMs = msSince(start);
+
+    long sum = 0;
+    start = Clock::now();
+    for(int i = 0; i < n; i++) {
+        sum += (tree.find(i) != tree.end());
+    }
+    cout << left << setw(10) << name << right << fixed << setprecision(1)
+         << setw(11) << removeMs << setw(11) << cleanupMs << setw(11) << msSince(start) << endl;
+    if(sum != n - n / 2) {
+        cout << "lost keys: " << sum << endl;
+    }
+}
+
+// Priority-queue use: n rounds of popMin and an insert of a larger key,
+// then popMax until the tree is empty.
+template<class Tree>
+void runQueue(const string& name, int n)
+{
+    mt19937 rng(3);
+    Tree tree;
+    for(int i = 0; i < n; i++) {
+        tree.insert(make_pair((int)(rng() % (2u * n)), i));
+    }
+
+    long sum = 0;
+    Clock::time_point start = Clock::now();
+    for(int i = 0; i < n; i++) {
+        pair<int, int> low = tree.popMin();
+        sum += low.second;
+        tree.insert(make_pair(low.first + (int)(rng() % (2u * n)), i));
+    }
+    double roundsMs = msSince(start);
+    start = Clock::now();
+    while(!tree.empty()) {
+        sum += tree.popMax().second;
+    }
+    cout << left << setw(10) << name << right << fixed << setprecision(1)
+         << setw(11) << roundsMs << setw(11) << msSince(start) << endl;
+    if(sum == 42) {
+        cout << sum;
+    }
+}
+
+void report(const string& name, const Result& r)
+{
+    cout << left << setw(8) << name << right << fixed << setprecision(1)
+         << setw(11) << r.insertMs
+         << setw(11) << r.sequentialMs
+         << setw(11) << r.findMs
+         << setw(11) << r.mixedMs
+         << setprecision(3) << setw(12) << r.rotationsPerUpdate
+         << setprecision(2) << setw(11) << r.averageDepth
+         << setw(8) << r.height << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    int n = 200000;
+    if(argc > 1) {
+        n = atoi(argv[1]);
+    }
+
+    cout << "n = " << n << " (times in ms)" << endl;
+    cout << left << setw(8) << "engine" << right
+         << setw(11) << "insert" << setw(11) << "ascending" << setw(11) << "find"
+         << setw(11) << "mixed" << setw(12) << "rot/update" << setw(11) << "avg depth"
+         << setw(8) << "height" << endl;
+
+    report("avl", runEngine<AVLTree<int, int> >(n, 1));
+    report("rb", runEngine<RBTree<int, int> >(n, 1));
+    report("treap", runEngine<Treap<int, int> >(n, 1));
+    report("wavl", runEngine<WAVLTree<int, int> >(n, 1));
+    report("splay", runEngine<SplayTree<int, int> >(n, 1));
+    report("scape", runEngine<ScapegoatTree<int, int> >(n, 1));
+
+    runCompaction(n);
+    runExport(n);
+    runScan(n);
+
+    cout << endl << "remove burst of " << n / 2 << " keys (ms)" << endl;
+    cout << left << setw(10) << "engine" << right << setw(11) << "remove" << setw(11) << "cleanup"
+         << setw(11) << "find" << endl;
+    AVLTree<int, int> eager;
+    runBurst("avl", eager, n, 0);
+    LazyAVLTree<int, int> automatic;
+    runBurst("lazy", automatic, n, 0);
+    LazyAVLTree<int, int> purged(1.0);
+    runBurst("purge", purged, n, 1);
+    LazyAVLTree<int, int> stepped(1.0);
+    runBurst("steps", stepped, n, 2);
+
+    cout << endl << "priority queue of " << n << " keys (ms)" << endl;
+    cout << left << setw(10) << "engine" << right << setw(11) << "pop+push" << setw(11) << "drain" << endl;
+    runQueue<AVLTree<int, int> >("avl", n);
+    runQueue<RBTree<int, int> >("rb", n);
+    runQueue<WAVLTree<int, int> >("wavl", n);
+    runQueue<SplayTree<int, int> >("splay", n);
+
+    return 0;
+}
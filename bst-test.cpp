@@ -1,7 +1,23 @@
 #include <iostream>
 #include <map>
+#include <vector>
+#include <string>
+#include <thread>
 #include "bst.h"
 #include "avlbst.h"
+#include "compactavl.h"
+#include "rbbst.h"
+#include "treapbst.h"
+#include "wavlbst.h"
+#include "splaybst.h"
+#include "scapegoatbst.h"
+#include "threadedavl.h"
+#include "lazyavl.h"
+#include "multiavl.h"
+#include "augmentedavl.h"
+#include "intervaltree.h"
+#include "hashindex.h"
+#include "lookupcache.h"
 #include "print_bst.h"
 
 using namespace std;
@@ -36,6 +52,478 @@ int main(int argc, char *argv[])
 
   at.print();
 
+    // Batched insert / remove
+    AVLTree<int, int> bt;
+    std::vector<std::pair<int, int> > batch;
+    for(int i = 0; i < 1000; i++) {
+        batch.push_back(std::make_pair(i, i * i));
+    }
+    bt.insertBatch(batch, 4);
+    std::vector<int> evens;
+    for(int i = 0; i < 1000; i += 2) {
+        evens.push_back(i);
+    }
+    bt.removeBatch(evens);
+    cout << "Batch: " << bt.manyNodes << " nodes, balanced: " << bt.isBalanced()
+         << ", 31 -> " << bt[31] << endl;
+
+    // Parallel reduce over the tree
+    long sum = bt.parallelReduce(0L,
+            [](const std::pair<const int, int>& item) { return (long)item.first; },
+            [](long a, long b) { return a + b; });
+    cout << "Parallel key sum: " << sum << endl;
+
+    // two callers sharing the pool take turns; a reduce from inside a
+    // pool task runs inline
+    AVLTree<int, int> first, second;
+    for(int i = 0; i < 20000; i++) {
+        first.insert(std::make_pair(i, 1));
+        second.insert(std::make_pair(i, 2));
+    }
+    auto count = [](const std::pair<const int, int>& item) { return (long)item.second; };
+    auto add = [](long a, long b) { return a + b; };
+    long firstSum = 0, secondSum = 0;
+    std::thread other([&]() { secondSum = second.parallelReduce(0L, count, add); });
+    firstSum = first.parallelReduce(0L, count, add);
+    other.join();
+    long nested = bt.parallelReduce(0L,
+            [&](const std::pair<const int, int>& item) { return (item.first == 31) ? first.parallelReduce(0L, count, add) : 0L; },
+            add);
+    cout << "Shared pool: " << firstSum << " " << secondSum << ", nested: " << nested << endl;
+
+    // a list from sorted inserts is cut by node count, not depth; the
+    // combine keeps the first key and whether the keys came in order
+    BinarySearchTree<int, int> chain;
+    for(int i = 0; i < 5000; i++) {
+        chain.insert(std::make_pair(i, i));
+    }
+    WorkStealingPool chainPool(4);
+    typedef std::pair<int, int> Run;    // (first key, last key), last -1 once out of order
+    Run run = chain.parallelReduce(Run(-1, -1),
+            [](const std::pair<const int, int>& item) { return Run(item.first, item.first); },
+            [](Run a, Run b) {
+                if(a.first < 0) return b;
+                if(b.first < 0) return a;
+                return Run(a.first, (a.second >= 0 && a.second + 1 == b.first) ? b.second : -1);
+            }, chainPool);
+    cout << "Parallel over a list: first " << run.first << ", last in order " << run.second << endl;
+
+    // Bulk load from unsorted pairs; the later pair for key 7 wins
+    AVLTree<int, int> ut;
+    std::vector<std::pair<int, int> > unsorted;
+    for(int i = 0; i < 10000; i++) {
+        unsorted.push_back(std::make_pair((i * 7919) % 10000, i));
+    }
+    unsorted.push_back(std::make_pair(7, -1));
+    ut.buildFromUnsorted(unsorted);
+    cout << "Unsorted build: " << ut.manyNodes << " nodes, balanced: " << ut.isBalanced()
+         << ", 7 -> " << ut[7] << endl;
+
+    // Heterogeneous lookup: no temporary std::string is built for the key
+    AVLTree<std::string, int> st;
+    st.insert(std::make_pair(std::string("alpha"), 1));
+    st.insert(std::make_pair(std::string("beta"), 2));
+    st.insert(std::make_pair(std::string("gamma"), 3));
+    const char* wanted = "beta";
+    st.remove("gamma");
+    cout << "String lookup: beta -> " << st.find(wanted)->second
+         << ", gamma found: " << (st.find("gamma") != st.end()) << endl;
+
+    // Index-based compact storage for small trivially copyable pairs
+    SelectAVLTree<uint16_t, uint16_t>::type ct;
+    ct.insert(std::make_pair(0, 9));
+    ct.insert(std::make_pair(1, 8));
+    ct.insert(std::make_pair(2, 159));
+    ct.remove(1);
+    cout << "Compact tree:";
+    for(CompactAVLTree<uint16_t, uint16_t>::iterator it = ct.begin(); it != ct.end(); ++it) {
+        cout << " (" << it->first << ", " << it->second << ")";
+    }
+    cout << ", balanced: " << ct.isBalanced() << endl;
+
+    // Other balanced engines behind the same interface
+    RBTree<int, int> rb;
+    Treap<int, int> treap;
+    WAVLTree<int, int> wavl;
+    BinarySearchTree<int, int>* engines[] = { &rb, &treap, &wavl };
+    for(int e = 0; e < 3; e++) {
+        for(int i = 0; i < 1000; i++) {
+            engines[e]->insert(std::make_pair(i, i));
+        }
+        for(int i = 0; i < 1000; i += 3) {
+            engines[e]->remove(i);
+        }
+    }
+    cout << "Engines: rb " << rb.manyNodes << ", treap " << treap.manyNodes
+         << ", wavl " << wavl.manyNodes << " nodes; 500 in all: "
+         << (rb.find(500) != rb.end() && treap.find(500) != treap.end() && wavl.find(500) != wavl.end()) << endl;
+
+    // Splaying moves an accessed key to the root, so finding it again
+    // does no rotations; depth threshold mode leaves shallow keys alone
+    SplayTree<int, int> splay;
+    for(int i = 0; i < 100; i++) {
+        splay.insert(std::make_pair(i, i * i));
+    }
+    splay.find(42);
+    unsigned long rotations = splay.rotationCount();
+    splay.find(42);
+    cout << "Splay: rotations for repeated find: " << splay.rotationCount() - rotations;
+    splay.setMode(SPLAY_DEPTH_THRESHOLD, 4);
+    splay.remove(42);
+    cout << ", 42 found after remove: " << (splay.find(42) != splay.end())
+         << ", 9 -> " << splay[9] << endl;
+    // sorted inserts leave a left list: 2j sits at depth 99 - j. A miss on
+    // 189 ends at 188, depth 5, which a threshold of 5 leaves alone
+    SplayTree<int, int> list(SPLAY_DEPTH_THRESHOLD, 5);
+    for(int i = 0; i < 200; i += 2) {
+        list.insert(std::make_pair(i, i));
+    }
+    rotations = list.rotationCount();
+    list.find(189);
+    cout << "Splay threshold: rotations for a miss at the threshold: " << list.rotationCount() - rotations;
+    SplayTree<std::string, int> words;
+    words.insert(std::make_pair(std::string("beta"), 2));
+    words.insert(std::make_pair(std::string("alpha"), 1));
+    words.insert(std::make_pair(std::string("gamma"), 3));
+    rotations = words.rotationCount();
+    int alpha = words["alpha"];
+    cout << ", [\"alpha\"] -> " << alpha << " splayed: " << (words.rotationCount() != rotations) << endl;
+
+    // Hinted inserts and finds start from the previous element, not the root
+    AVLTree<int, int> ht;
+    for(int i = 0; i < 1000; i += 2) {
+        ht.insert(std::make_pair(i, i));
+    }
+    AVLTree<int, int>::iterator hint = ht.end();
+    for(int i = 1; i < 1000; i += 2) {
+        hint = ht.insert(hint, std::make_pair(i, i));
+    }
+    hint = ht.find(hint, 998);
+    cout << "Hinted: " << ht.manyNodes << " nodes, balanced: " << ht.isBalanced()
+         << ", 998 -> " << hint->second << ", 12 -> " << ht.find(hint, 12)->second << endl;
+
+    // Multimap: copies of a key are kept in insertion order
+    AVLMultiTree<int, char> events;
+    events.insert(std::make_pair(5, 'a'));
+    events.insert(std::make_pair(3, 'x'));
+    events.insert(std::make_pair(5, 'b'));
+    events.insert(std::make_pair(5, 'c'));
+    events.insert(std::make_pair(7, 'y'));
+    cout << "Multimap: count(5) = " << events.count(5) << ", in order:";
+    std::pair<AVLMultiTree<int, char>::iterator, AVLMultiTree<int, char>::iterator> range = events.equal_range(5);
+    for(AVLMultiTree<int, char>::iterator it = range.first; it != range.second; ++it) {
+        cout << " " << it->second;
+    }
+    cout << ", erased " << events.erase(5) << ", left " << events.manyNodes << endl;
+
+    // heterogeneous find takes the oldest copy as well
+    AVLMultiTree<std::string, int> tags;
+    for(int i = 0; i < 20; i++) {
+        tags.insert(std::make_pair(std::string((i % 4 == 0) ? "hot" : "cold"), i));
+    }
+    cout << "Multimap oldest: " << tags.find("hot")->second << " " << tags.find("cold")->second
+         << ", count: " << tags.count("hot") << endl;
+
+    // Subtree aggregates: range sums and order statistics in O(log n)
+    AugmentedAVLTree<int, int, ValueSum<int, int> > sums;
+    OrderStatisticTree<int, int> ranks;
+    for(int i = 1; i <= 100; i++) {
+        sums.insert(std::make_pair(i, i));
+        ranks.insert(std::make_pair(i * 10, i));
+    }
+    sums.remove(50);
+    ranks.remove(500);
+    cout << "Aggregates: sum 41..60 = " << sums.rangeAggregate(41, 60)
+         << ", 10th smallest = " << ranks.select(9)->first
+         << ", rank of 600 = " << ranks.rank(600) << endl;
+
+    // Interval tree: the max end per subtree prunes the search
+    IntervalTree<int, char> windows;
+    windows.insert(0, 10, 'a');
+    windows.insert(5, 8, 'b');
+    windows.insert(9, 20, 'c');
+    windows.insert(30, 40, 'd');
+    cout << "Intervals: stabbing 9:";
+    windows.stabbing(9, [](const std::pair<const Interval<int>, char>& item) { cout << " " << item.second; });
+    cout << ", overlapping [15, 35):";
+    windows.overlapping(15, 35, [](const std::pair<const Interval<int>, char>& item) { cout << " " << item.second; });
+    cout << endl;
+
+    // Hash index: point lookups skip the tree, iteration still uses it
+    HashIndexedTree<int, int> indexed;
+    for(int i = 0; i < 1000; i++) {
+        indexed.insert(std::make_pair((i * 7) % 1000, i));
+    }
+    for(int i = 0; i < 1000; i += 2) {
+        indexed.remove(i);
+    }
+    indexed.insert(indexed.find(501), std::make_pair(502, -1));
+    cout << "Hash index: 501 -> " << indexed[501] << ", 502 -> " << indexed[502]
+         << ", 500 found: " << (indexed.find(500) != indexed.end())
+         << ", first: " << indexed.begin()->first << endl;
+    AVLTree<int, int>& indexedEngine = indexed;
+    indexedEngine.clear();
+    indexed.insert(std::make_pair(3, 9));
+    cout << "Hash index after engine clear: 501 found: " << (indexed.find(501) != indexed.end())
+         << ", 3 -> " << indexed[3] << endl;
+
+    // Lookup cache: misses are cached too, until the next update
+    CachedLookupTree<int, int> cached;
+    for(int i = 0; i < 1000; i += 2) {
+        cached.insert(std::make_pair(i, i * i));
+    }
+    bool missBefore = (cached.find(7) == cached.end()) && (cached.find(7) == cached.end());
+    cached.insert(std::make_pair(7, 49));
+    cout << "Lookup cache: 30 -> " << cached[30] << ", 7 missing: " << missBefore
+         << ", 7 after insert -> " << cached[7] << endl;
+    BinarySearchTree<int, int>& cachedBase = cached;
+    cachedBase.clear();
+    cout << "Lookup cache after base clear: 7 found: " << (cached.find(7) != cached.end()) << endl;
+
+    // Compaction: nodes move into one arena, the tree is unchanged
+    AVLTree<int, int> packed;
+    for(int i = 0; i < 2000; i++) {
+        packed.insert(std::make_pair((i * 37) % 2000, i));
+    }
+    for(int i = 0; i < 2000; i += 3) {
+        packed.remove(i);
+    }
+    size_t heapBytes = packed.memoryUsage();
+    packed.compact();
+    packed.remove(1);
+    packed.insert(std::make_pair(2000, 0));
+    long keySum = 0;
+    for(AVLTree<int, int>::iterator it = packed.begin(); it != packed.end(); ++it) {
+        keySum += it->first;
+    }
+    cout << "Compact: smaller: " << (packed.memoryUsage() < heapBytes) << ", balanced: " << packed.isBalanced()
+         << ", key sum: " << keySum << ", 1000 -> " << packed[1000] << endl;
+
+    // Stepwise relocation: bounded steps, with updates in between
+    RBTree<int, int> moving;
+    for(int i = 0; i < 1000; i++) {
+        moving.insert(std::make_pair((i * 7) % 1000, i));
+    }
+    int relocateSteps = 1;
+    while(!moving.relocateStep(100)) {
+        moving.remove(relocateSteps * 50);
+        relocateSteps++;
+    }
+    cout << "Relocation: " << relocateSteps << " steps, " << moving.manyNodes << " left, 7 -> " << moving[7]
+         << ", 50 found: " << (moving.find(50) != moving.end()) << endl;
+
+    // removing every node a step has moved so far must not free the arena
+    // the pass is still filling
+    AVLTree<int, int> emptied;
+    for(int i = 0; i < 100; i++) {
+        emptied.insert(std::make_pair(i, i));
+    }
+    emptied.relocateStep(10);
+    for(int i = 0; i < 10; i++) {
+        emptied.remove(i);
+    }
+    int emptiedSteps = 1;
+    while(!emptied.relocateStep(10)) {
+        emptiedSteps++;
+    }
+    cout << "Relocation after removes: " << emptiedSteps << " steps, " << emptied.manyNodes << " left, 10 -> "
+         << emptied[10] << ", balanced: " << emptied.isBalanced() << endl;
+
+    // Export: the top two levels as JSON, keys 3..5 as DOT
+    AVLTree<int, int> exported;
+    for(int i = 1; i <= 7; i++) {
+        exported.insert(std::make_pair(i, i * 10));
+    }
+    cout << "Export: ";
+    exported.exportTree(cout, EXPORT_JSON, 1);
+    exported.exportTree(cout, EXPORT_DOT, 3, 5);
+
+    // Scapegoat: sorted inserts no longer make a list, and removing most
+    // keys rebuilds the whole tree
+    ScapegoatTree<int, int> scapegoat;
+    for(int i = 0; i < 1000; i++) {
+        scapegoat.insert(std::make_pair(i, i * 2));
+    }
+    bool sortedShallow = true;
+    for(int i = 0; i < 1000; i++) {
+        int depth = 0;
+        for(Node<int, int>* node = scapegoat.find(i).current_; node != NULL; node = node->getParent()) {
+            depth++;
+        }
+        sortedShallow = sortedShallow && depth <= 20;
+    }
+    for(int i = 0; i < 1000; i++) {
+        if(i % 10 != 0) {
+            scapegoat.remove(i);
+        }
+    }
+    cout << "Scapegoat: depth within log_{1/0.7}(n): " << sortedShallow << ", " << scapegoat.manyNodes
+         << " left, 500 -> " << scapegoat[500] << ", rebuilt: " << (scapegoat.rebuiltNodes() > 0) << endl;
+    BinarySearchTree<int, int>& scapegoatBase = scapegoat;
+    scapegoatBase.clear();
+    for(int i = 0; i < 10; i++) {
+        scapegoat.insert(std::make_pair(i, i));
+    }
+    unsigned long rebuiltBefore = scapegoat.rebuiltNodes();
+    scapegoat.remove(0);
+    cout << "Scapegoat after base clear: one remove rebuilds: " << (scapegoat.rebuiltNodes() != rebuiltBefore) << endl;
+
+    // DSW rebalance: a list of sorted inserts becomes a complete tree and
+    // iterators into it stay valid
+    BinarySearchTree<int, int> vine;
+    for(int i = 0; i < 1000; i++) {
+        vine.insert(std::make_pair(i, -i));
+    }
+    BinarySearchTree<int, int>::iterator kept = vine.find(999);
+    bool wasBalanced = vine.isBalanced();
+    vine.rebalance();
+    int deepest = 0;
+    for(BinarySearchTree<int, int>::iterator it = vine.begin(); it != vine.end(); ++it) {
+        int depth = 0;
+        for(Node<int, int>* node = it.current_; node != NULL; node = node->getParent()) {
+            depth++;
+        }
+        deepest = std::max(deepest, depth);
+    }
+    cout << "Rebalance: balanced before: " << wasBalanced << ", after: " << vine.isBalanced()
+         << ", levels: " << deepest << ", kept: " << kept->second << ", rotations counted: " << vine.rotationCount() << endl;
+    RBTree<int, int> recolored;
+    for(int i = 0; i < 1000; i++) {
+        recolored.insert(std::make_pair(i, i));
+    }
+    BinarySearchTree<int, int>& recoloredBase = recolored;
+    recoloredBase.rebalance();
+    for(int i = 1000; i < 1100; i++) {
+        recolored.insert(std::make_pair(i, i));
+    }
+    for(int i = 0; i < 1100; i += 2) {
+        recolored.remove(i);
+    }
+    cout << "Rebalance through base on red-black: " << recolored.manyNodes << " left, 1099 -> "
+         << recolored[1099] << endl;
+
+    // cached ends: walk back from end(), then drain the tree from both
+    // sides as a double-ended priority queue
+    AVLTree<int, int> queue;
+    int scrambled[] = {5, 1, 9, 3, 7, 2, 8};
+    for(int i = 0; i < 7; i++) {
+        queue.insert(std::make_pair(scrambled[i], scrambled[i] * 10));
+    }
+    cout << "Ends: backwards:";
+    BinarySearchTree<int, int>::iterator back = queue.end();
+    for(--back; back != queue.end(); --back) {
+        cout << " " << back->first;
+    }
+    cout << ", rbegin: " << queue.rbegin()->first << ", popped:";
+    while(!queue.empty()) {
+        std::pair<int, int> low = queue.popMin();
+        cout << " " << low.first;
+        if(!queue.empty()) {
+            cout << " " << queue.popMax().first;
+        }
+    }
+    bool threw = false;
+    try {
+        queue.popMax();
+    }
+    catch(std::out_of_range&) {
+        threw = true;
+    }
+    cout << ", empty throws: " << threw << endl;
+
+    // threaded AVL: iterators follow the in-order links, which have to
+    // survive removes of two-child nodes, batches and compaction
+    ThreadedAVLTree<int, int> threaded;
+    for(int i = 0; i < 20; i++) {
+        threaded.insert(std::make_pair((i * 7) % 20, i));
+    }
+    for(int i = 0; i < 20; i += 3) {
+        threaded.remove(i);
+    }
+    std::vector<int> dropped;
+    dropped.push_back(1);
+    dropped.push_back(19);
+    threaded.removeBatch(dropped);
+    threaded.compact();
+    cout << "Threaded:";
+    for(BinarySearchTree<int, int>::iterator it = threaded.begin(); it != threaded.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << " | backwards:";
+    BinarySearchTree<int, int>::iterator last = threaded.end();
+    for(--last; last != threaded.end(); --last) {
+        cout << " " << last->first;
+    }
+    cout << endl;
+
+    // prefetching scan: same items in the same order as the iterator, at
+    // any distance
+    Treap<int, int> scanned;
+    for(int i = 0; i < 500; i++) {
+        scanned.insert(std::make_pair((i * 37) % 500, i));
+    }
+    bool sameOrder = true;
+    for(size_t distance = 0; distance <= 8; distance += 4) {
+        BinarySearchTree<int, int>::iterator plain = scanned.begin();
+        BinarySearchTree<int, int>::scan_iterator it = scanned.scan(distance);
+        for(; it != scanned.end() && plain != scanned.end(); ++it, ++plain) {
+            sameOrder = sameOrder && it->first == plain->first && it->second == plain->second;
+        }
+        sameOrder = sameOrder && it == scanned.end() && plain == scanned.end();
+    }
+    Treap<int, int> none;
+    cout << "Scan: same order: " << sameOrder << ", empty at end: " << (none.scan() == none.end()) << endl;
+
+    // lazy deletion: removed keys stay linked as tombstones until a purge,
+    // but no lookup, iterator or scan shows them
+    LazyAVLTree<int, int> lazy(1.0);
+    for(int i = 1; i <= 12; i++) {
+        lazy.insert(std::make_pair(i, i * 10));
+    }
+    for(int i = 1; i <= 12; i += 2) {
+        lazy.remove(i);
+    }
+    lazy.insert(std::make_pair(5, 55));
+    cout << "Lazy: size " << lazy.size() << ", tombstones " << lazy.tombstones()
+         << ", find(3) at end: " << (lazy.find(3) == lazy.end()) << ", [5] = " << lazy[5] << ", items:";
+    for(BinarySearchTree<int, int>::iterator it = lazy.begin(); it != lazy.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << " | scan:";
+    for(BinarySearchTree<int, int>::scan_iterator it = lazy.scan(); it != lazy.end(); ++it) {
+        cout << " " << it->first;
+    }
+    lazy.popMin();
+    int steps = 1;
+    while(!lazy.purgeStep(4)) {
+        steps++;
+    }
+    cout << " | purgeStep passes " << steps << ", tombstones " << lazy.tombstones();
+    lazy.remove(12);
+    lazy.remove(10);
+    lazy.purge();
+    cout << ", after purge: size " << lazy.size() << ", tombstones " << lazy.tombstones()
+         << ", balanced " << lazy.isBalanced() << endl;
+
+    // a hinted insert goes through the engine too, so it revives a tombstone
+    LazyAVLTree<int, int> revived(1.0);
+    for(int i = 1; i <= 5; i++) {
+        revived.insert(std::make_pair(i, i));
+    }
+    revived.remove(3);
+    BinarySearchTree<int, int>::iterator reinserted = revived.insert(revived.find(2), std::make_pair(3, 30));
+    cout << "Hinted revive: size " << revived.size() << ", tombstones " << revived.tombstones()
+         << ", 3 -> " << reinserted->second << endl;
+
+    // tombstones stay hidden from the base class: lookups and parallel walks
+    revived.remove(4);
+    BinarySearchTree<int, int>& revivedBase = revived;
+    WorkStealingPool walkers(4);
+    int visibleSum = revivedBase.parallelReduce(0, [](std::pair<const int, int>& item) { return item.second; },
+                                                [](int a, int b) { return a + b; }, walkers);
+    cout << "Lazy through base: find(4) at end: " << (revivedBase.find(4) == revivedBase.end())
+         << ", value sum " << visibleSum << endl;
+
 
     return 0;
 }
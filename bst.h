@@ -6,6 +6,18 @@
 #include <cstdlib>
 #include <utility>
 #include <algorithm>
+#include <vector>
+#include <functional>
+#include <type_traits>
+#include "thread_pool.h"
+#include "nodearena.h"
+
+// Default lookahead of BinarySearchTree::scan: how many upcoming pending
+// nodes have their right subtree prefetched. Picked from the scan table
+// of bst-bench; override with -DBST_SCAN_DISTANCE=n (0 turns it off).
+#ifndef BST_SCAN_DISTANCE
+#define BST_SCAN_DISTANCE 4
+#endif
 
 
 
@@ -189,6 +201,49 @@ void Node<Key, Value>::setValue(const Value& value)
   ---------------------------------------
 */
 
+/**
+* True when K can be compared with Key using < in both directions, which
+* is what the heterogeneous lookups need. Plays the role of the
+* is_transparent tag of std::less<>: a std::string keyed tree can be
+* searched with a const char* without building a temporary string.
+*/
+template <typename Key, typename K>
+struct IsTransparentKey
+{
+    template <typename A, typename B>
+    static auto test(int) -> decltype(std::declval<const A&>() < std::declval<const B&>(),
+                                      std::declval<const B&>() < std::declval<const A&>(),
+                                      std::true_type());
+    template <typename A, typename B>
+    static std::false_type test(...);
+
+    static const bool value = decltype(test<Key, K>(0))::value;
+};
+
+/**
+* Node order for BinarySearchTree::compact.
+*
+* COMPACT_IN_ORDER places nodes by key, so a scan walks memory forwards.
+* COMPACT_VEB uses the van Emde Boas layout: the top half of the levels
+* is laid out first (recursively the same way), then each subtree below
+* it, so every descent touches few cache lines and pages at any scale.
+*/
+enum CompactOrder
+{
+    COMPACT_IN_ORDER,
+    COMPACT_VEB
+};
+
+/**
+* Output format for BinarySearchTree::exportTree (see export_bst.h).
+*/
+enum ExportFormat
+{
+    EXPORT_DOT,
+    EXPORT_JSON,
+    EXPORT_BINARY
+};
+
 /**
 * A templated unbalanced binary search tree.
 */
@@ -198,12 +253,13 @@ class BinarySearchTree
 public:
     BinarySearchTree(); //TODO
     virtual ~BinarySearchTree(); //TODO
-    virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
+    void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
     virtual void remove(const Key& key); //TODO
     void clear(); //TODO
     bool isBalanced() const; //TODO
     void print() const;
-    bool empty() const;
+    virtual bool empty() const;
+    unsigned long rotationCount() const;
 
     int manyNodes;
 
@@ -225,23 +281,128 @@ public:
         bool operator!=(const iterator& rhs) const;
 
         iterator& operator++();
+        iterator& operator--();
         Node<Key, Value> * current_;
+        const BinarySearchTree<Key, Value>* tree_;  // for --end(); NULL if not known
     protected:
         friend class BinarySearchTree<Key, Value>;
-        iterator(Node<Key,Value>* ptr);
+        iterator(Node<Key,Value>* ptr, const BinarySearchTree<Key, Value>* tree = NULL);
        
     };
 
+    /**
+    * A forward-only iterator for full scans of big trees. It keeps the
+    * pending ancestors on its own stack instead of climbing parent links,
+    * and prefetches the right child of the next few of them, so the
+    * misses on the subtrees still to come overlap with the walk instead
+    * of being taken one node at a time. Compares equal to end() once done.
+    */
+    class scan_iterator
+    {
+    public:
+        scan_iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        scan_iterator& operator++();
+        Node<Key, Value> * current_;
+    protected:
+        friend class BinarySearchTree<Key, Value>;
+        scan_iterator(const BinarySearchTree<Key, Value>* tree, size_t distance);
+        size_t descend(Node<Key, Value>* node);
+        void advance(size_t pushed);
+        void skipHidden();
+        static void prefetchRight(Node<Key, Value>* node);
+
+        const BinarySearchTree<Key, Value>* tree_;
+        std::vector<Node<Key, Value>*> pending_;    // next to visit on top
+        size_t distance_;
+    };
+
 public:
     iterator begin() const;
     iterator end() const;
+    // In-order scan with prefetching; see scan_iterator.
+    scan_iterator scan(size_t distance = BST_SCAN_DISTANCE) const;
+
+    // The tree keeps its smallest and largest nodes at hand, so begin()
+    // and rbegin() (the largest item) are O(1), and --end() is rbegin().
+    // Walking back from rbegin() with -- ends at end(). popMin and popMax
+    // remove and return the smallest and largest item, so the tree can
+    // serve as an ordered priority queue; both throw on an empty tree.
+    iterator rbegin() const;
+    std::pair<Key, Value> popMin();
+    std::pair<Key, Value> popMax();
     iterator find(const Key& key) const;
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
 
+    // Lookups with any type comparable with Key, without converting it.
+    template<typename K, typename = typename std::enable_if<IsTransparentKey<Key, K>::value>::type>
+    iterator find(const K& key) const;
+    template<typename K, typename = typename std::enable_if<IsTransparentKey<Key, K>::value>::type>
+    Value& operator[](const K& key);
+    template<typename K, typename = typename std::enable_if<IsTransparentKey<Key, K>::value>::type>
+    Value const & operator[](const K& key) const;
+    template<typename K, typename = typename std::enable_if<IsTransparentKey<Key, K>::value>::type>
+    void remove(const K& key);
+
+    // Finger search: start from a nearby element (e.g. the one inserted or
+    // found last) instead of the root. end() as the hint means the root.
+    iterator insert(const iterator& hint, const std::pair<const Key, Value>& keyValuePair);
+    iterator find(const iterator& hint, const Key& key) const;
+
+    // Memory accounting. memoryUsage() estimates the bytes held for the
+    // nodes, including allocator overhead and any side index. compact()
+    // moves every node into one contiguous arena; iterators and hints
+    // into the tree do not survive it.
+    virtual size_t memoryUsage() const;
+    void compact(CompactOrder order = COMPACT_VEB);
+
+    // Incremental compaction, for trees that must keep serving: each call
+    // moves at most budget nodes into a fresh arena, in key order, and
+    // returns true once a whole pass is done. Between calls the tree is
+    // used as usual; iterators do not survive a call.
+    bool relocateStep(size_t budget = 256);
+
+    // Day-Stout-Warren: relinks the nodes of a plain (unbalanced) tree
+    // into a complete tree in place, O(n) time and O(1) extra memory.
+    // No node moves, so iterators stay valid. Engines whose nodes carry
+    // balance data (AVL, red-black, WAVL, treap) override it to recompute
+    // that data in one more O(n) pass.
+    virtual void rebalance();
+
+    // Parallel traversal. The key order is cut into ranges of about the
+    // same number of nodes, whatever the shape, that are visited on the
+    // pool; the tree must not be modified meanwhile.
+    // Concurrent callers of one pool take turns, and a call made from a
+    // task running on the pool does its work inline.
+    template<typename Visitor>
+    void parallelForEach(Visitor visit, WorkStealingPool& pool = WorkStealingPool::shared()) const;
+    template<typename T, typename Map, typename Combine>
+    T parallelReduce(const T& identity, Map map, Combine combine,
+                     WorkStealingPool& pool = WorkStealingPool::shared()) const;
+
+    // Streaming export for debugging trees of any size, as Graphviz DOT,
+    // JSON or a compact binary format. One pass, memory bounded by the
+    // height. Only levels down to maxDepth (the root is level 0, -1 for
+    // all) and, in the second form, keys in [low, high] are written.
+    void exportTree(std::ostream& out, ExportFormat format, int maxDepth = -1) const;
+    void exportTree(std::ostream& out, ExportFormat format, const Key& low, const Key& high, int maxDepth = -1) const;
+
 protected:
     // Mandatory helper functions
     Node<Key, Value>* internalFind(const Key& k) const; // TODO
+    template<typename K>
+    Node<Key, Value>* findNode(const K& key) const;
+    template<typename K>
+    Node<Key, Value>* findNodeFrom(Node<Key, Value>* start, const K& key) const;
+    template<typename K>
+    Node<Key, Value>* climbFrom(Node<Key, Value>* hint, const K& key) const;
     Node<Key, Value> *getSmallestNode() const;  // TODO
     static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
     // Note:  static means these functions don't have a "this" pointer
@@ -254,7 +415,6 @@ protected:
     virtual void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2) ;
 
     // Add helper functions here
-    Node <Key, Value>*recursiveInsert(Node<Key, Value>* root, Node<Key, Value>* addition);
     bool isLeaf(Node<Key, Value>* current);
     bool oneChild(Node<Key, Value>* current);
     bool twoChild(Node<Key, Value>* current);
@@ -264,10 +424,84 @@ protected:
     bool isLeftChild(Node<Key, Value>* current);
     int getHeight(Node<Key, Value>* root) const;
     void const recursiveBalanced(Node<Key, Value>* root, int& falses) const;
+    static void collectCuts(Node<Key, Value>* root, int depth, std::vector<Node<Key, Value>*>& cuts);
+    template<typename Visitor>
+    Node<Key, Value>* visitRange(Node<Key, Value>* first, Node<Key, Value>* stop, size_t budget, Visitor& visit) const;
+    template<typename T, typename Walk>
+    std::vector<T> walkInRanges(const T& identity, Walk walk, WorkStealingPool& pool) const;
+    void vebOrder(Node<Key, Value>* root, int height, std::vector<Node<Key, Value>*>& out) const;
+    template<typename Writer>
+    void exportNodes(Writer& writer, const Key* low, const Key* high, int maxDepth) const;
+
+    // Node type hooks for memoryUsage and compact; each engine names its
+    // own node type.
+    virtual size_t nodeSize() const;
+    virtual Node<Key, Value>* relocateNode(Node<Key, Value>* node, NodeArena& arena);
+    // Called when relocateStep has replaced from with its copy to, for
+    // anything that keeps pointers to nodes.
+    virtual void nodeMoved(Node<Key, Value>* from, Node<Key, Value>* to);
+    Node<Key, Value>* moveNode(Node<Key, Value>* node, NodeArena& arena);
+    void endRelocation();
+
+    // Upkeep of leftmost_ and rightmost_. trackInsert is called for a new
+    // leaf once it is linked in, trackRemoval for a node about to be
+    // unlinked (after any swap), and refreshEnds after bulk changes that
+    // build, replace or free nodes some other way (clear, compact, the
+    // AVL batches). Rotations keep the order, so they need nothing. An
+    // engine or wrapper that keeps more per-node state (threads, a key
+    // index) extends these.
+    virtual void trackInsert(Node<Key, Value>* leaf);
+    virtual void trackRemoval(Node<Key, Value>* node);
+    virtual void refreshEnds();
+    // Where iterators step to: successor and predecessor unless the
+    // engine keeps in-order links or hides some nodes. From NULL they give
+    // the first and the last item, which begin() and rbegin() return.
+    virtual Node<Key, Value>* nextNode(Node<Key, Value>* node) const;
+    virtual Node<Key, Value>* previousNode(Node<Key, Value>* node) const;
+    // True for a node that is still linked in but not part of the
+    // contents (a tombstone); scans, parallel walks and lookups pass over
+    // it. find and operator[] go through lookupNode, which an engine or
+    // wrapper with a faster way to a key's node overrides.
+    virtual bool hiddenNode(Node<Key, Value>* node) const;
+    virtual Node<Key, Value>* lookupNode(const Key& key) const;
+    Node<Key, Value>* visibleNode(Node<Key, Value>* node) const;
+    // Removes a node of this tree. By key through remove() unless an
+    // engine can unlink the node directly.
+    virtual void eraseNode(Node<Key, Value>* node);
+
+    // State of an unfinished relocateStep pass: the arena being filled
+    // and the key to go on from.
+    struct Relocation
+    {
+        Relocation(size_t count, const Key& key) : arena(count), next(key), pastEqual(false) { }
+
+        NodeArena arena;
+        Key next;
+        bool pastEqual;     // start after the copies of next, not at them
+    };
+
+    // Inserts (or overwrites) item, descending from start, a node whose
+    // subtree spans the key (root_ for a plain insert), and returns the
+    // node that holds it. Every insert, hinted or not, comes here, so this
+    // is what engines implement and what trees keeping their own
+    // bookkeeping override.
+    virtual Node<Key, Value>* insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& item);
+
+    // Building blocks shared by the balanced engines
+    Node<Key, Value>* findInsertPoint(Node<Key, Value>* start, const Key& key, Node<Key, Value>*& parent) const;
+    void attachLeaf(Node<Key, Value>* parent, Node<Key, Value>* leaf);
+    void replaceChild(Node<Key, Value>* parent, Node<Key, Value>* oldChild, Node<Key, Value>* newChild);
+    Node<Key, Value>* rotateLeftNode(Node<Key, Value>* n1);
+    Node<Key, Value>* rotateRightNode(Node<Key, Value>* n1);
 
 protected:
     Node<Key, Value>* root_;
     // You should not need other data members
+    unsigned long rotations_;   // rotations done by single-key updates, for benchmarking
+    NodeArena::Slab* arena_;        // handle on the slab of the last compact, or NULL
+    Relocation* relocation_;        // pass in progress, or NULL
+    Node<Key, Value>* leftmost_;    // smallest node, or NULL for an empty tree
+    Node<Key, Value>* rightmost_;   // largest node, or NULL for an empty tree
 };
 
 /*
@@ -280,8 +514,8 @@ Begin implementations for the BinarySearchTree::iterator class.
 * Explicit constructor that initializes an iterator with a given node pointer.
 */
 template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr)
-        : current_(ptr)
+BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr, const BinarySearchTree<Key, Value>* tree)
+        : current_(ptr), tree_(tree)
 {
     // A.M.
 
@@ -291,7 +525,7 @@ BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr)
 * A default constructor that initializes the iterator to NULL.
 */
 template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator() : current_(nullptr)
+BinarySearchTree<Key, Value>::iterator::iterator() : current_(nullptr), tree_(nullptr)
 {
     // A.M.
 
@@ -383,12 +617,151 @@ BinarySearchTree<Key, Value>::iterator::operator++()
 {
     // A.M //
 
-    this->current_ = (successor(current_));
+    this->current_ = (tree_ != NULL) ? tree_->nextNode(current_) : successor(current_);
+
+    return *this;
+
+}
+
+/**
+* Steps back to the previous item in order. From end() this is the
+* largest item of the tree the iterator came from.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator&
+BinarySearchTree<Key, Value>::iterator::operator--()
+{
+    if(tree_ != NULL){
+        current_ = tree_->previousNode(current_);
+    }
+    else if(current_ != NULL){
+        current_ = predecessor(current_);
+    }
+    return *this;
+}
+
+
+/**
+* An empty scan.
+*/
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::scan_iterator::scan_iterator() : current_(NULL), tree_(NULL), distance_(0)
+{
+
+}
+
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::scan_iterator::scan_iterator(const BinarySearchTree<Key, Value>* tree, size_t distance)
+        : current_(NULL), tree_(tree), distance_(distance)
+{
+    advance(descend(tree->root_));
+    skipHidden();
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value> &
+BinarySearchTree<Key, Value>::scan_iterator::operator*() const
+{
+    return current_->getItem();
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value> *
+BinarySearchTree<Key, Value>::scan_iterator::operator->() const
+{
+    return &(current_->getItem());
+}
+
+/**
+* A scan is at end() when it has no node left, and otherwise equal to an
+* iterator on the same node.
+*/
+template<class Key, class Value>
+bool BinarySearchTree<Key, Value>::scan_iterator::operator==(const iterator& rhs) const
+{
+    return current_ == rhs.current_;
+}
+
+template<class Key, class Value>
+bool BinarySearchTree<Key, Value>::scan_iterator::operator!=(const iterator& rhs) const
+{
+    return current_ != rhs.current_;
+}
 
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::scan_iterator&
+BinarySearchTree<Key, Value>::scan_iterator::operator++()
+{
+    advance(descend(current_->getRight()));
+    skipHidden();
     return *this;
+}
+
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::scan_iterator::skipHidden()
+{
+    while(current_ != NULL && tree_->hiddenNode(current_)){
+        advance(descend(current_->getRight()));
+    }
+}
+
+/**
+* Pushes node and its left spine; returns how many nodes that was.
+*/
+template<class Key, class Value>
+size_t BinarySearchTree<Key, Value>::scan_iterator::descend(Node<Key, Value>* node)
+{
+    size_t pushed = 0;
+    while(node != NULL){
+        pending_.push_back(node);
+        pushed++;
+        node = node->getLeft();
+    }
+    return pushed;
+}
+
+/**
+* Takes the next node off the stack. The prefetch window is the current
+* node and the distance_ - 1 pending nodes above the rest: a new left
+* spine fills it from the top; otherwise one node slides into it from
+* below, and only that one is new.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::scan_iterator::advance(size_t pushed)
+{
+    if(pending_.empty()){
+        current_ = NULL;
+        return;
+    }
+    current_ = pending_.back();
+    pending_.pop_back();
+    if(distance_ == 0){
+        return;
+    }
 
+    size_t size = pending_.size();
+    if(pushed > 0){
+        for(size_t i = size + 1 - std::min(pushed, distance_); i < size; i++){
+            prefetchRight(pending_[i]);
+        }
+        prefetchRight(current_);
+    }
+    else if(size + 1 >= distance_){
+        size_t entering = size + 1 - distance_;
+        prefetchRight(entering == size ? current_ : pending_[entering]);
+    }
 }
 
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::scan_iterator::prefetchRight(Node<Key, Value>* node)
+{
+    Node<Key, Value>* right = node->getRight();
+    if(right != NULL){
+#if defined(__GNUC__)
+        __builtin_prefetch(right);
+#endif
+    }
+}
 
 /*
 -------------------------------------------------------------
@@ -406,7 +779,7 @@ Begin implementations for the BinarySearchTree class.
 * Default constructor for a BinarySearchTree, which sets the root to NULL.
 */
 template<class Key, class Value>
-BinarySearchTree<Key, Value>::BinarySearchTree() : root_(NULL)
+BinarySearchTree<Key, Value>::BinarySearchTree() : root_(NULL), rotations_(0), arena_(NULL), relocation_(NULL), leftmost_(NULL), rightmost_(NULL)
 {
     // AM
     manyNodes = 0;
@@ -430,6 +803,15 @@ bool BinarySearchTree<Key, Value>::empty() const
     return root_ == NULL;
 }
 
+/**
+* Number of rotations done so far by insert and remove.
+*/
+template<class Key, class Value>
+unsigned long BinarySearchTree<Key, Value>::rotationCount() const
+{
+    return rotations_;
+}
+
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::print() const
 {
@@ -444,7 +826,7 @@ template<class Key, class Value>
 typename BinarySearchTree<Key, Value>::iterator
 BinarySearchTree<Key, Value>::begin() const
 {
-    BinarySearchTree<Key, Value>::iterator begin(getSmallestNode());
+    BinarySearchTree<Key, Value>::iterator begin(nextNode(NULL), this);
     return begin;
 }
 
@@ -455,10 +837,52 @@ template<class Key, class Value>
 typename BinarySearchTree<Key, Value>::iterator
 BinarySearchTree<Key, Value>::end() const
 {
-    BinarySearchTree<Key, Value>::iterator end(NULL);
+    BinarySearchTree<Key, Value>::iterator end(NULL, this);
     return end;
 }
 
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::scan_iterator
+BinarySearchTree<Key, Value>::scan(size_t distance) const
+{
+    return scan_iterator(this, distance);
+}
+
+/**
+* Returns an iterator to the "largest" item in the tree
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::rbegin() const
+{
+    BinarySearchTree<Key, Value>::iterator last(previousNode(NULL), this);
+    return last;
+}
+
+/**
+* Removes the smallest item and returns it. The tree's own removal does
+* the unlinking (see eraseNode), so it costs what a remove costs there.
+*/
+template<class Key, class Value>
+std::pair<Key, Value> BinarySearchTree<Key, Value>::popMin()
+{
+    Node<Key, Value>* first = nextNode(NULL);
+    if(first == NULL) throw std::out_of_range("Empty tree");
+    std::pair<Key, Value> item(first->getKey(), first->getValue());
+    eraseNode(first);
+    return item;
+}
+
+template<class Key, class Value>
+std::pair<Key, Value> BinarySearchTree<Key, Value>::popMax()
+{
+    Node<Key, Value>* last = previousNode(NULL);
+    if(last == NULL) throw std::out_of_range("Empty tree");
+    std::pair<Key, Value> item(last->getKey(), last->getValue());
+    eraseNode(last);
+    return item;
+}
+
 /**
 * Returns an iterator to the item with the given key, k
 * or the end iterator if k does not exist in the tree
@@ -467,8 +891,8 @@ template<class Key, class Value>
 typename BinarySearchTree<Key, Value>::iterator
 BinarySearchTree<Key, Value>::find(const Key & k) const
 {
-    Node<Key, Value> *curr = internalFind(k);
-    BinarySearchTree<Key, Value>::iterator it(curr);
+    Node<Key, Value> *curr = lookupNode(k);
+    BinarySearchTree<Key, Value>::iterator it(curr, this);
     return it;
 }
 
@@ -479,36 +903,67 @@ BinarySearchTree<Key, Value>::find(const Key & k) const
 template<class Key, class Value>
 Value& BinarySearchTree<Key, Value>::operator[](const Key& key)
 {
-    Node<Key, Value> *curr = internalFind(key);
+    Node<Key, Value> *curr = lookupNode(key);
     if(curr == NULL) throw std::out_of_range("Invalid key");
     return curr->getValue();
 }
 template<class Key, class Value>
 Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
 {
-    Node<Key, Value> *curr = internalFind(key);
+    Node<Key, Value> *curr = lookupNode(key);
     if(curr == NULL) throw std::out_of_range("Invalid key");
     return curr->getValue();
 }
 
+/**
+* Heterogeneous versions of find and operator[]: key is compared against
+* the stored keys directly instead of being converted to Key first.
+*/
+template<class Key, class Value>
+template<typename K, typename>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::find(const K& key) const
+{
+    BinarySearchTree<Key, Value>::iterator it(visibleNode(findNode(key)), this);
+    return it;
+}
 
 template<class Key, class Value>
-Node <Key, Value>* BinarySearchTree<Key, Value>::recursiveInsert(Node<Key, Value>* root, Node<Key, Value>* addition){
-    if(root == NULL){
-        root = addition;
-        manyNodes++;
+template<typename K, typename>
+Value& BinarySearchTree<Key, Value>::operator[](const K& key)
+{
+    Node<Key, Value> *curr = visibleNode(findNode(key));
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
 
+template<class Key, class Value>
+template<typename K, typename>
+Value const & BinarySearchTree<Key, Value>::operator[](const K& key) const
+{
+    Node<Key, Value> *curr = visibleNode(findNode(key));
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+/**
+* Heterogeneous remove. The lookup needs no conversion; the matching key is
+* then copied and passed to the virtual remove, so derived trees keep their
+* own removal logic and never see a reference into the node being freed.
+*/
+template<class Key, class Value>
+template<typename K, typename>
+void BinarySearchTree<Key, Value>::remove(const K& key)
+{
+    Node<Key, Value> *curr = findNode(key);
+    if(curr == NULL){
+        return;
     }
-    else if(addition->getKey() < root->getKey()){
-        addition->setParent(root);
-        root->setLeft(recursiveInsert(root->getLeft(), addition));
-    }
-    else{
-        addition->setParent(root);
-        root->setRight(recursiveInsert(root->getRight(), addition));
-    }
-    return root;
+    Key stored(curr->getKey());
+    remove(stored);
 }
+
+
 /**
 * An insert method to insert into a Binary Search Tree.
 * The tree will not remain balanced when inserting.
@@ -518,26 +973,25 @@ Node <Key, Value>* BinarySearchTree<Key, Value>::recursiveInsert(Node<Key, Value
 template<class Key, class Value>
 void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
 {
-    // AM //
-    if(empty()){
-        Node<Key, Value>* addition = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, NULL);
-        root_ = addition;
-        manyNodes++;
-        return;
-    }
-
-    if(find(keyValuePair.first) != end()){
-        BinarySearchTree<Key, Value>::iterator it = find(keyValuePair.first);
-        it.current_->setValue(keyValuePair.second);
-        return;
-    }
+    insertFrom(root_, keyValuePair);
+}
 
-    else{
-        Node<Key, Value>* addition = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, NULL);
-        recursiveInsert(root_, addition);
+/**
+* The plain tree's insert: a new leaf where the search ends, no rebalancing.
+*/
+template<class Key, class Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& item)
+{
+    Node<Key, Value>* parent;
+    Node<Key, Value>* existing = findInsertPoint(start, item.first, parent);
+    if(existing != NULL){
+        existing->setValue(item.second);
+        return existing;
     }
 
-
+    Node<Key, Value>* addition = new Node<Key, Value>(item.first, item.second, NULL);
+    attachLeaf(parent, addition);
+    return addition;
 }
 
 
@@ -550,12 +1004,28 @@ template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::remove(const Key& key)
 {
     // TODO
-    if(find(key) == end()){
+    // internalFind, not find: a wrapper may already have dropped key from
+    // whatever lookupNode consults
+    Node<Key, Value>* current = internalFind(key);
+    if(current == NULL){
         return;
     }
 
     else{
-        Node<Key, Value>* current = find(key).current_;
+
+        //------------------------
+        // CASE OF TWO CHILDREN
+        // Swap with the predecessor, which leaves current with at most one
+        // child, then unlink it below. The node is not looked up again by
+        // key since it now sits out of order until it is gone.
+
+        if(twoChild(current)){
+            nodeSwap(current, predecessor(current));
+        }
+        trackRemoval(current);
+
+        //END CASE OF TWO CHILDREN
+        //------------------------
 
         //------------------------
         // CASE OF LEAF NODE
@@ -648,17 +1118,6 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
 
             //END CASE OF ONE CHILD
             //------------------------
-
-            //------------------------
-            // CASE OF TWO CHILDREN
-
-        else if(twoChild(current)){
-            nodeSwap(current, predecessor(current));
-            remove(current->getKey());
-        }
-
-        //END CASE OF TWO CHILDREN
-        //------------------------
     }
 }
 
@@ -836,17 +1295,41 @@ BinarySearchTree<Key, Value>::successor(Node<Key, Value> *current) {
 /**
 * A method to remove all contents of the tree and
 * reset the values in the tree for use again.
+* Nodes are freed bottom-up by climbing the parent links, so this is O(n)
+* with no recursion even when the tree is a long path (e.g. a splay tree
+* after sorted inserts), and no rebalancing is done along the way.
 */
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::clear()
 {
-
-
-    while(!empty()) {
-        remove(getSmallestNode()->getKey());
+    Node<Key, Value>* current = root_;
+    while(current != NULL) {
+        if(current->getLeft() != NULL) {
+            current = current->getLeft();
+        }
+        else if(current->getRight() != NULL) {
+            current = current->getRight();
+        }
+        else {
+            Node<Key, Value>* parent = current->getParent();
+            if(parent != NULL) {
+                if(parent->getLeft() == current) {
+                    parent->setLeft(NULL);
+                }
+                else {
+                    parent->setRight(NULL);
+                }
+            }
+            delete current;
+            current = parent;
+        }
     }
     root_ = NULL;
-
+    manyNodes = 0;
+    endRelocation();
+    NodeArena::releaseHandle(arena_);
+    arena_ = NULL;
+    refreshEnds();
 }
 
 
@@ -858,17 +1341,7 @@ Node<Key, Value>*
 BinarySearchTree<Key, Value>::getSmallestNode() const
 {
 
-    if(empty()){
-        return NULL;
-    }
-
-    Node<Key, Value>* result = root_;
-
-    while(result->getLeft()!=NULL){
-        result = result->getLeft();
-    }
-
-    return result;
+    return leftmost_;
 }
 
 /**
@@ -881,20 +1354,43 @@ Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) con
 {
     // A.M //
 
-    Node<Key, Value>* result = NULL;
+    return findNode(key);
+}
 
-    if(empty()){
-        return result;
-    }
+/**
+* Descends from the root comparing key against the node keys with < only,
+* so key can be of any type that IsTransparentKey accepts.
+*/
+template<typename Key, typename Value>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value>::findNode(const K& key) const
+{
+    return findNodeFrom(root_, key);
+}
+
+/**
+* Like findNode, but descends from start, whose subtree must be the only
+* place key can be (see climbFrom).
+*/
+template<typename Key, typename Value>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value>::findNodeFrom(Node<Key, Value>* start, const K& key) const
+{
+    Node<Key, Value>* current = start;
 
-    for(BinarySearchTree<Key, Value>::iterator it = begin(); it != end(); ++it){
-        if(it.current_->getKey() == key){
-            result = it.current_;
-            return result;
+    while(current != NULL){
+        if(key < current->getKey()){
+            current = current->getLeft();
+        }
+        else if(current->getKey() < key){
+            current = current->getRight();
+        }
+        else{
+            return current;
         }
     }
 
-    return result;
+    return NULL;
 }
 
 /**
@@ -1017,22 +1513,791 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
         this->root_ = n1;
     }
 
+    // the two nodes traded places, so they trade roles too
+    if(leftmost_ == n1) leftmost_ = n2;
+    else if(leftmost_ == n2) leftmost_ = n1;
+    if(rightmost_ == n1) rightmost_ = n2;
+    else if(rightmost_ == n2) rightmost_ = n1;
 }
 
 /**
- * Lastly, we are providing you with a print function,
-   BinarySearchTree::printRoot().
-   Just call it with a node to start printing at, e.g:
-   this->printRoot(this->root_) // or any other node pointer
+* Appends, in key order, the nodes less than depth levels below root.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::collectCuts(Node<Key, Value>* root, int depth, std::vector<Node<Key, Value>*>& cuts)
+{
+    if(root == NULL || depth == 0){
+        return;
+    }
+    collectCuts(root->getLeft(), depth - 1, cuts);
+    cuts.push_back(root);
+    collectCuts(root->getRight(), depth - 1, cuts);
+}
 
-   It will print up to 5 levels of the tree rooted at the passed node,
-   in ASCII graphics format.
-   We hope it will make debugging easier!
-  */
+/**
+* Visits the nodes from first up to, not including, stop in key order,
+* passing over hidden ones, and gives up after budget of them. Returns
+* the node it stopped at, which is stop once the range is done.
+*/
+template<typename Key, typename Value>
+template<typename Visitor>
+Node<Key, Value>* BinarySearchTree<Key, Value>::visitRange(Node<Key, Value>* first, Node<Key, Value>* stop, size_t budget, Visitor& visit) const
+{
+    Node<Key, Value>* current = first;
+    for(size_t steps = 0; current != stop && steps < budget; steps++){
+        if(!hiddenNode(current)){
+            visit(current->getItem());
+        }
+        current = successor(current);
+    }
+    return current;
+}
+
+/**
+* Runs walk(partial, first, stop, budget) on the pool over ranges that
+* together cover the key order once, and returns the partials in key
+* order. walk handles the range [first, stop) up to budget nodes and
+* returns where it stopped.
+*
+* The first cut is by depth: the nodes near the root split the key order
+* into about four ranges per thread, each walked with a budget of twice
+* its fair share. That is all a reasonably balanced tree needs. A range
+* that runs out of budget (in a degenerate tree, nearly everything is one
+* range) has what is left of it counted and cut into ranges of a fair
+* share each, which a second round walks in full. Only oversized ranges
+* pay for that counting walk.
+*/
+template<typename Key, typename Value>
+template<typename T, typename Walk>
+std::vector<T> BinarySearchTree<Key, Value>::walkInRanges(const T& identity, Walk walk, WorkStealingPool& pool) const
+{
+    std::vector<T> ordered;
+    if(root_ == NULL){
+        return ordered;
+    }
+
+    // about four ranges per thread, so stealing can even out uneven ones
+    size_t wanted = 4 * (size_t)pool.size();
+    int depth = 0;
+    while(((size_t)1 << depth) < wanted && depth < 20){
+        depth++;
+    }
+    std::vector<Node<Key, Value>*> starts(1, getSmallestNode());
+    collectCuts(root_, depth, starts);
+    std::vector<Node<Key, Value>*> stops(starts.begin() + 1, starts.end());
+    stops.push_back(NULL);
+
+    size_t share = (size_t)manyNodes / wanted + 1;
+    std::vector<T> partials(starts.size(), identity);
+    std::vector<Node<Key, Value>*> stopped(starts.size());
+    std::vector<std::function<void()> > tasks;
+    for(size_t i = 0; i < starts.size(); i++){
+        T* partial = &partials[i];
+        Node<Key, Value>** at = &stopped[i];
+        Node<Key, Value>* first = starts[i];
+        Node<Key, Value>* stop = stops[i];
+        tasks.push_back([&walk, partial, at, first, stop, share](){
+            *at = walk(*partial, first, stop, 2 * share);
+        });
+    }
+    pool.run(tasks);
+
+    // cut what the budgets left over into fair shares; owner[j] is the
+    // first-round range that second-round range j belongs to
+    std::vector<Node<Key, Value>*> restStarts;
+    std::vector<Node<Key, Value>*> restStops;
+    std::vector<size_t> owner;
+    for(size_t i = 0; i < starts.size(); i++){
+        Node<Key, Value>* from = stopped[i];
+        size_t count = 0;
+        for(Node<Key, Value>* current = from; current != stops[i]; current = successor(current)){
+            if(count == share){
+                restStarts.push_back(from);
+                restStops.push_back(current);
+                owner.push_back(i);
+                from = current;
+                count = 0;
+            }
+            count++;
+        }
+        if(count > 0){
+            restStarts.push_back(from);
+            restStops.push_back(stops[i]);
+            owner.push_back(i);
+        }
+    }
+    std::vector<T> rest(restStarts.size(), identity);
+    if(!restStarts.empty()){
+        tasks.clear();
+        for(size_t j = 0; j < restStarts.size(); j++){
+            T* partial = &rest[j];
+            Node<Key, Value>* first = restStarts[j];
+            Node<Key, Value>* stop = restStops[j];
+            tasks.push_back([&walk, partial, first, stop](){
+                walk(*partial, first, stop, (size_t)-1);
+            });
+        }
+        pool.run(tasks);
+    }
+
+    size_t next = 0;
+    for(size_t i = 0; i < starts.size(); i++){
+        ordered.push_back(partials[i]);
+        while(next < rest.size() && owner[next] == i){
+            ordered.push_back(rest[next]);
+            next++;
+        }
+    }
+    return ordered;
+}
+
+/**
+* Calls visit on every item, in parallel. Items in the same range are
+* visited in key order, but ranges run concurrently, so visit must be
+* safe to call from several threads at once. There is no key-ordered
+* mode: visits in key order could not overlap, so the pool would add
+* nothing over an iterator. parallelReduce combines in key order.
+*/
+template<typename Key, typename Value>
+template<typename Visitor>
+void BinarySearchTree<Key, Value>::parallelForEach(Visitor visit, WorkStealingPool& pool) const
+{
+    walkInRanges((char)0, [this, &visit](char&, Node<Key, Value>* first, Node<Key, Value>* stop, size_t budget){
+        return visitRange(first, stop, budget, visit);
+    }, pool);
+}
+
+/**
+* Maps every item and folds the results with combine, in parallel. The
+* partial results are combined in key order, so combine only has to be
+* associative, not commutative; identity must be its neutral element.
+*/
+template<typename Key, typename Value>
+template<typename T, typename Map, typename Combine>
+T BinarySearchTree<Key, Value>::parallelReduce(const T& identity, Map map, Combine combine, WorkStealingPool& pool) const
+{
+    std::vector<T> partials = walkInRanges(identity, [this, &map, &combine](T& partial, Node<Key, Value>* first, Node<Key, Value>* stop, size_t budget){
+        auto fold = [&partial, &map, &combine](std::pair<const Key, Value>& item){
+            partial = combine(partial, map(item));
+        };
+        return visitRange(first, stop, budget, fold);
+    }, pool);
+
+    T result = identity;
+    for(size_t i = 0; i < partials.size(); i++){
+        result = combine(result, partials[i]);
+    }
+    return result;
+}
+
+/**
+* Descends from start towards key. Returns the node holding it if there
+* is one; otherwise returns NULL and leaves in parent the node a new leaf
+* for key should hang from (NULL for an empty tree).
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::findInsertPoint(Node<Key, Value>* start, const Key& key, Node<Key, Value>*& parent) const
+{
+    parent = NULL;
+    Node<Key, Value>* current = start;
+
+    while(current != NULL){
+        if(key < current->getKey()){
+            parent = current;
+            current = current->getLeft();
+        }
+        else if(current->getKey() < key){
+            parent = current;
+            current = current->getRight();
+        }
+        else{
+            return current;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+* Climbs from hint to a node whose subtree spans key, i.e. one a search
+* from the root for key would pass through, and returns it (the root for
+* a NULL hint). For a key above the hint only the upper end of the range
+* is in doubt, and it is set by the nearest ancestor the climb reaches
+* through a left child link, so the climb goes through right child links
+* without comparing and stops at the first left link whose parent is
+* above key (symmetrically for keys below the hint). A key next to the
+* hint is usually settled within a level or two.
+*/
+template<typename Key, typename Value>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value>::climbFrom(Node<Key, Value>* hint, const K& key) const
+{
+    if(hint == NULL){
+        return root_;
+    }
+
+    Node<Key, Value>* current = hint;
+    if(current->getKey() < key){
+        Node<Key, Value>* climb = current;
+        while(climb->getParent() != NULL){
+            Node<Key, Value>* parent = climb->getParent();
+            if(parent->getLeft() == climb){
+                if(key < parent->getKey()){
+                    break;
+                }
+                current = parent;
+            }
+            climb = parent;
+        }
+    }
+    else if(key < current->getKey()){
+        Node<Key, Value>* climb = current;
+        while(climb->getParent() != NULL){
+            Node<Key, Value>* parent = climb->getParent();
+            if(parent->getRight() == climb){
+                if(parent->getKey() < key){
+                    break;
+                }
+                current = parent;
+            }
+            climb = parent;
+        }
+    }
+    return current;
+}
+
+/**
+* Finds key starting from the hint rather than the root.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::find(const iterator& hint, const Key& key) const
+{
+    BinarySearchTree<Key, Value>::iterator it(visibleNode(findNodeFrom(climbFrom(hint.current_, key), key)), this);
+    return it;
+}
+
+/**
+* Inserts (or overwrites) keyValuePair, searching from the hint rather than
+* the root, and returns an iterator to it so a stream of nearly sorted
+* keys can pass each result on as the next hint. The engine's insertFrom
+* does the work, overwrites included, so each engine rebalances and keeps
+* its bookkeeping as usual; it just starts its descent from the
+* climbed-to node.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::insert(const iterator& hint, const std::pair<const Key, Value>& keyValuePair)
+{
+    Node<Key, Value>* start = climbFrom(hint.current_, keyValuePair.first);
+    BinarySearchTree<Key, Value>::iterator it(insertFrom(start, keyValuePair), this);
+    return it;
+}
+
+/**
+* Hangs a new leaf below parent on the side its key belongs (equal keys go
+* right), or makes it the root if parent is NULL.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::attachLeaf(Node<Key, Value>* parent, Node<Key, Value>* leaf)
+{
+    leaf->setParent(parent);
+    if(parent == NULL){
+        root_ = leaf;
+    }
+    else if(leaf->getKey() < parent->getKey()){
+        parent->setLeft(leaf);
+    }
+    else{
+        parent->setRight(leaf);
+    }
+    manyNodes++;
+    trackInsert(leaf);
+}
+
+/**
+* Points parent (or root_, for a NULL parent) at newChild where it used to
+* point at oldChild, and fixes newChild's parent.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::replaceChild(Node<Key, Value>* parent, Node<Key, Value>* oldChild, Node<Key, Value>* newChild)
+{
+    if(parent == NULL){
+        root_ = newChild;
+    }
+    else if(parent->getLeft() == oldChild){
+        parent->setLeft(newChild);
+    }
+    else{
+        parent->setRight(newChild);
+    }
+    if(newChild != NULL){
+        newChild->setParent(parent);
+    }
+}
+
+/**
+* Rotates n1 down to the left; its right child takes its place, including
+* as root_. Returns that child. Engine specific metadata is not touched.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::rotateLeftNode(Node<Key, Value>* n1)
+{
+    Node<Key, Value>* n2 = n1->getRight();
+    replaceChild(n1->getParent(), n1, n2);
+    n1->setRight(n2->getLeft());
+    if(n1->getRight() != NULL){
+        n1->getRight()->setParent(n1);
+    }
+    n2->setLeft(n1);
+    n1->setParent(n2);
+    rotations_++;
+    return n2;
+}
+
+/**
+* Mirror image of rotateLeftNode.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::rotateRightNode(Node<Key, Value>* n1)
+{
+    Node<Key, Value>* n2 = n1->getLeft();
+    replaceChild(n1->getParent(), n1, n2);
+    n1->setLeft(n2->getRight());
+    if(n1->getLeft() != NULL){
+        n1->getLeft()->setParent(n1);
+    }
+    n2->setRight(n1);
+    n1->setParent(n2);
+    rotations_++;
+    return n2;
+}
+
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::nodeSize() const
+{
+    return sizeof(Node<Key, Value>);
+}
+
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::relocateNode(Node<Key, Value>* node, NodeArena& arena)
+{
+    return arena.copy(*node);
+}
+
+/**
+* Heap nodes are counted at their malloc footprint. Compacted nodes are
+* counted through their slab, which stays whole (holes from removed nodes
+* included) until its last node goes.
+*/
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::memoryUsage() const
+{
+    size_t arenaNodes = 0;
+    size_t arenaBytes = 0;
+    if(arena_ != NULL && arena_->nodes > 0){
+        arenaNodes += arena_->nodes;
+        arenaBytes += arena_->bytes;
+    }
+    // the open arena of a relocateStep pass counts itself among its nodes
+    NodeArena::Slab* pass = (relocation_ != NULL) ? relocation_->arena.handle() : NULL;
+    if(pass != NULL){
+        arenaNodes += pass->nodes - 1;
+        arenaBytes += pass->bytes;
+    }
+    return ((size_t)manyNodes - arenaNodes) * NodeArena::heapFootprint(nodeSize()) + arenaBytes;
+}
+
+/**
+* Rotates the tree into a vine (every node the right child of the one
+* before), then runs left rotations down the vine: first one per node
+* of the incomplete bottom level, then passes halving in length, each
+* of which folds the vine into one more level. The rotations keep the
+* parent links and are not counted in rotations_.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::rebalance()
+{
+    unsigned long counted = rotations_;
+    long count = 0;
+    Node<Key, Value>* current = root_;
+    while(current != NULL){
+        if(current->getLeft() != NULL){
+            current = rotateRightNode(current);
+        }
+        else{
+            count++;
+            current = current->getRight();
+        }
+    }
+
+    // full: nodes in the complete levels
+    long full = 0;
+    while(2 * full + 1 <= count){
+        full = 2 * full + 1;
+    }
+    long rotations = count - full;
+    for(;;){
+        current = root_;
+        for(long i = 0; i < rotations; i++){
+            current = rotateLeftNode(current)->getRight();
+        }
+        if(full <= 1){
+            break;
+        }
+        full /= 2;
+        rotations = full;
+    }
+    rotations_ = counted;
+}
+
+/**
+* Copies every node into a fresh arena in the given order, relinks the
+* copies and frees the originals. This gives back the holes a long run
+* of removes leaves in the heap and puts nodes used together next to
+* each other. O(n log log n) for COMPACT_VEB, O(n) otherwise.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::compact(CompactOrder order)
+{
+    endRelocation();
+    std::vector<Node<Key, Value>*> nodes;
+    nodes.reserve(manyNodes);
+    if(order == COMPACT_VEB){
+        int height = 0;
+        std::vector<std::pair<Node<Key, Value>*, int> > stack;
+        if(root_ != NULL){
+            stack.push_back(std::make_pair(root_, 1));
+        }
+        while(!stack.empty()){
+            std::pair<Node<Key, Value>*, int> top = stack.back();
+            stack.pop_back();
+            height = std::max(height, top.second);
+            if(top.first->getLeft() != NULL){
+                stack.push_back(std::make_pair(top.first->getLeft(), top.second + 1));
+            }
+            if(top.first->getRight() != NULL){
+                stack.push_back(std::make_pair(top.first->getRight(), top.second + 1));
+            }
+        }
+        vebOrder(root_, height, nodes);
+    }
+    else{
+        for(Node<Key, Value>* current = getSmallestNode(); current != NULL; current = successor(current)){
+            nodes.push_back(current);
+        }
+    }
+
+    NodeArena arena(nodes.size());
+    std::vector<Node<Key, Value>*> copies;
+    copies.reserve(nodes.size());
+    try{
+        for(size_t i = 0; i < nodes.size(); i++){
+            copies.push_back(relocateNode(nodes[i], arena));
+        }
+    }
+    catch(...){
+        for(size_t i = 0; i < copies.size(); i++){
+            delete copies[i];
+        }
+        NodeArena::releaseHandle(arena.close());
+        throw;
+    }
+
+    // each original forwards to its copy through its parent link, so the
+    // copies, which still point at originals, can be relinked
+    for(size_t i = 0; i < nodes.size(); i++){
+        nodes[i]->setParent(copies[i]);
+    }
+    for(size_t i = 0; i < copies.size(); i++){
+        Node<Key, Value>* copy = copies[i];
+        if(copy->getParent() != NULL){
+            copy->setParent(copy->getParent()->getParent());
+        }
+        if(copy->getLeft() != NULL){
+            copy->setLeft(copy->getLeft()->getParent());
+        }
+        if(copy->getRight() != NULL){
+            copy->setRight(copy->getRight()->getParent());
+        }
+    }
+    if(root_ != NULL){
+        root_ = root_->getParent();
+    }
+    for(size_t i = 0; i < nodes.size(); i++){
+        delete nodes[i];
+    }
+    refreshEnds();
+
+    NodeArena::releaseHandle(arena_);
+    arena_ = arena.close();
+}
+
+/**
+* One bounded step of an incremental compact. The pass walks the keys in
+* order from where the last step stopped, so inserts, removes and
+* rotations in between do no harm, and copies each node it meets that is
+* not yet in the pass's arena. Placing nodes by key keeps every subtree
+* in one contiguous run of memory, so the lower levels of a descent stay
+* within a page or two; the top levels are hot in any case.
+*
+* budget bounds the nodes visited, moved or not, so a call costs
+* O(budget + log n). A pass ends at the largest key, or early if the tree
+* has grown past the arena sized at its start; keys inserted behind the
+* cursor wait for the next pass, as do the rest of a run of equal keys
+* (in a multimap) longer than budget.
+*/
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::relocateStep(size_t budget)
+{
+    if(root_ == NULL){
+        endRelocation();
+        return true;
+    }
+    if(relocation_ == NULL){
+        relocation_ = new Relocation(manyNodes, getSmallestNode()->getKey());
+    }
+
+    // first node not below the cursor, or above it when the last step
+    // ended inside a run of equal keys it could not get through
+    Node<Key, Value>* current = NULL;
+    for(Node<Key, Value>* walk = root_; walk != NULL; ){
+        bool below = relocation_->pastEqual ? !(relocation_->next < walk->getKey()) : (walk->getKey() < relocation_->next);
+        if(below){
+            walk = walk->getRight();
+        }
+        else{
+            current = walk;
+            walk = walk->getLeft();
+        }
+    }
+
+    NodeArena& arena = relocation_->arena;
+    for(size_t visited = 0; current != NULL && (visited < budget || visited == 0) && !arena.full(); visited++){
+        if(!arena.holds(current)){
+            current = moveNode(current, arena);
+        }
+        current = successor(current);
+    }
+
+    if(current == NULL || arena.full()){
+        NodeArena::releaseHandle(arena_);
+        arena_ = arena.close();
+        delete relocation_;
+        relocation_ = NULL;
+        return true;
+    }
+    relocation_->pastEqual = !(relocation_->next < current->getKey());
+    relocation_->next = current->getKey();
+    return false;
+}
+
+/**
+* Replaces node by a copy in arena: the parent (or root_) and the
+* children are pointed at the copy, as nodeSwap does, and node is freed.
+* Returns the copy.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::moveNode(Node<Key, Value>* node, NodeArena& arena)
+{
+    Node<Key, Value>* copy = relocateNode(node, arena);
+    Node<Key, Value>* parent = copy->getParent();
+    if(parent == NULL){
+        root_ = copy;
+    }
+    else if(parent->getLeft() == node){
+        parent->setLeft(copy);
+    }
+    else{
+        parent->setRight(copy);
+    }
+    if(copy->getLeft() != NULL){
+        copy->getLeft()->setParent(copy);
+    }
+    if(copy->getRight() != NULL){
+        copy->getRight()->setParent(copy);
+    }
+    if(leftmost_ == node){
+        leftmost_ = copy;
+    }
+    if(rightmost_ == node){
+        rightmost_ = copy;
+    }
+    nodeMoved(node, copy);
+    delete node;
+    return copy;
+}
+
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::nodeMoved(Node<Key, Value>* from, Node<Key, Value>* to)
+{
+
+}
+
+/**
+* Abandons a relocateStep pass. Nodes already moved stay where they are.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::endRelocation()
+{
+    if(relocation_ != NULL){
+        NodeArena::releaseHandle(relocation_->arena.close());
+        delete relocation_;
+        relocation_ = NULL;
+    }
+}
+
+/**
+* A new leaf is the smallest node exactly when it went left of the old
+* smallest one, and likewise for the largest.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::trackInsert(Node<Key, Value>* leaf)
+{
+    Node<Key, Value>* parent = leaf->getParent();
+    if(parent == NULL){
+        leftmost_ = leaf;
+        rightmost_ = leaf;
+        return;
+    }
+    if(parent == leftmost_ && parent->getLeft() == leaf){
+        leftmost_ = leaf;
+    }
+    if(parent == rightmost_ && parent->getRight() == leaf){
+        rightmost_ = leaf;
+    }
+}
+
+/**
+* Called while node is still linked in, so its neighbours can be found.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::trackRemoval(Node<Key, Value>* node)
+{
+    if(node == leftmost_){
+        leftmost_ = successor(node);
+    }
+    if(node == rightmost_){
+        rightmost_ = predecessor(node);
+    }
+}
+
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::refreshEnds()
+{
+    leftmost_ = root_;
+    rightmost_ = root_;
+    if(root_ == NULL){
+        return;
+    }
+    while(leftmost_->getLeft() != NULL){
+        leftmost_ = leftmost_->getLeft();
+    }
+    while(rightmost_->getRight() != NULL){
+        rightmost_ = rightmost_->getRight();
+    }
+}
+
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::nextNode(Node<Key, Value>* node) const
+{
+    return (node == NULL) ? leftmost_ : successor(node);
+}
+
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::previousNode(Node<Key, Value>* node) const
+{
+    return (node == NULL) ? rightmost_ : predecessor(node);
+}
+
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::hiddenNode(Node<Key, Value>*) const
+{
+    return false;
+}
+
+/**
+* The visible node holding key, or NULL. A plain descent here.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::lookupNode(const Key& key) const
+{
+    return visibleNode(findNode(key));
+}
+
+/**
+* node, or NULL if node is NULL or hidden.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::visibleNode(Node<Key, Value>* node) const
+{
+    return (node != NULL && hiddenNode(node)) ? NULL : node;
+}
+
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::eraseNode(Node<Key, Value>* node)
+{
+    Key key = node->getKey();
+    remove(key);
+}
+
+/**
+* Appends the nodes of root's subtree that are less than height levels
+* down, in van Emde Boas order.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::vebOrder(Node<Key, Value>* root, int height, std::vector<Node<Key, Value>*>& out) const
+{
+    if(root == NULL || height <= 0){
+        return;
+    }
+    if(height == 1){
+        out.push_back(root);
+        return;
+    }
+
+    int top = height / 2;
+    vebOrder(root, top, out);
+
+    // roots of the bottom subtrees, top levels down, left to right
+    std::vector<Node<Key, Value>*> bottoms;
+    std::vector<std::pair<Node<Key, Value>*, int> > stack(1, std::make_pair(root, 0));
+    while(!stack.empty()){
+        std::pair<Node<Key, Value>*, int> current = stack.back();
+        stack.pop_back();
+        if(current.second == top){
+            bottoms.push_back(current.first);
+            continue;
+        }
+        if(current.first->getRight() != NULL){
+            stack.push_back(std::make_pair(current.first->getRight(), current.second + 1));
+        }
+        if(current.first->getLeft() != NULL){
+            stack.push_back(std::make_pair(current.first->getLeft(), current.second + 1));
+        }
+    }
+    for(size_t i = 0; i < bottoms.size(); i++){
+        vebOrder(bottoms[i], height - top, out);
+    }
+}
+
+/**
+ * Lastly, we are providing you with a print function,
+   BinarySearchTree::printRoot().
+   Just call it with a node to start printing at, e.g:
+   this->printRoot(this->root_) // or any other node pointer
+
+   It will print up to 5 levels of the tree rooted at the passed node,
+   in ASCII graphics format.
+   We hope it will make debugging easier!
+  */
 
 // include print function (in its own file because it's fairly long)
 #include "print_bst.h"
 
+// and the streaming exporter
+#include "export_bst.h"
+
 /*
 ---------------------------------------------------
 End implementations for the BinarySearchTree class.
@@ -0,0 +1,682 @@
+#ifndef COMPACTAVL_H
+#define COMPACTAVL_H
+
+#include <iostream>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include "avlbst.h"
+
+/**
+* An AVL tree for small, trivially copyable keys and values.
+*
+* Nodes live in one contiguous array and refer to each other by 32-bit
+* index instead of by pointer, and there is no vtable. For
+* CompactAVLTree<uint16_t, uint16_t> a node is 20 bytes against 48 for an
+* AVLNode, and neighbouring nodes share cache lines. Indices limit a tree
+* to 2^32 - 1 entries.
+*
+* The public interface mirrors AVLTree (insert/remove/find/operator[]/
+* iterators), but there are no Node pointers to hand out, so the protected
+* helpers of BinarySearchTree do not exist here. Inserting or removing may
+* move nodes inside the array, so iterators do not survive updates.
+*/
+template <typename Key, typename Value>
+class CompactAVLTree
+{
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                  "CompactAVLTree needs trivially copyable keys and values");
+
+public:
+    typedef uint32_t Index;
+    static const Index NIL = 0xFFFFFFFFu;
+
+    CompactAVLTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    void reserve(size_t count);
+    size_t memoryUsage() const;
+    void compact(CompactOrder order = COMPACT_VEB);
+    bool empty() const;
+    size_t size() const;
+    bool isBalanced() const;
+
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key, Value>& operator*() const;
+        std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class CompactAVLTree<Key, Value>;
+        iterator(CompactAVLTree<Key, Value>* tree, Index current);
+
+        CompactAVLTree<Key, Value>* tree_;
+        Index current_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    struct CompactNode
+    {
+        CompactNode(const Key& key, const Value& value, Index parent);
+
+        std::pair<const Key, Value> item;
+        Index parent;
+        Index left;
+        Index right;
+        int8_t balance;
+    };
+
+    Index internalFind(const Key& key) const;
+    Index successor(Index current) const;
+    Index allocateNode(const Key& key, const Value& value, Index parent);
+    void replaceChild(Index parent, Index oldChild, Index newChild);
+    Index rotateLeftAt(Index n1);
+    Index rotateRightAt(Index n1);
+    Index rebalanceAt(Index n1);
+    void retraceInsert(Index child);
+    void retraceRemove(Index parent, bool fromLeft);
+    int checkBalanced(Index root, bool& balanced) const;
+    void vebOrder(Index root, int height, std::vector<Index>& out) const;
+    void collectDepth(Index root, int depth, std::vector<Index>& out) const;
+
+    std::vector<CompactNode> nodes_;
+    std::vector<Index> free_;
+    Index root_;
+    size_t count_;
+};
+
+/**
+* Picks CompactAVLTree when both key and value are trivially copyable and
+* at most 8 bytes each, and AVLTree otherwise.
+*/
+template <typename Key, typename Value>
+struct SelectAVLTree
+{
+    static const bool compact = std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value
+                                && sizeof(Key) <= 8 && sizeof(Value) <= 8;
+    typedef typename std::conditional<compact, CompactAVLTree<Key, Value>, AVLTree<Key, Value> >::type type;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the CompactAVLTree class.
+  -------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+const typename CompactAVLTree<Key, Value>::Index CompactAVLTree<Key, Value>::NIL;
+
+template<typename Key, typename Value>
+CompactAVLTree<Key, Value>::CompactNode::CompactNode(const Key& key, const Value& value, Index parentIndex) :
+        item(key, value),
+        parent(parentIndex),
+        left(NIL),
+        right(NIL),
+        balance(0)
+{
+
+}
+
+template<typename Key, typename Value>
+CompactAVLTree<Key, Value>::iterator::iterator() : tree_(NULL), current_(NIL)
+{
+
+}
+
+template<typename Key, typename Value>
+CompactAVLTree<Key, Value>::iterator::iterator(CompactAVLTree<Key, Value>* tree, Index current) :
+        tree_(tree),
+        current_(current)
+{
+
+}
+
+template<typename Key, typename Value>
+std::pair<const Key, Value>& CompactAVLTree<Key, Value>::iterator::operator*() const
+{
+    return tree_->nodes_[current_].item;
+}
+
+template<typename Key, typename Value>
+std::pair<const Key, Value>* CompactAVLTree<Key, Value>::iterator::operator->() const
+{
+    return &(tree_->nodes_[current_].item);
+}
+
+template<typename Key, typename Value>
+bool CompactAVLTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return current_ == rhs.current_ && (current_ == NIL || tree_ == rhs.tree_);
+}
+
+template<typename Key, typename Value>
+bool CompactAVLTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::iterator& CompactAVLTree<Key, Value>::iterator::operator++()
+{
+    current_ = tree_->successor(current_);
+    return *this;
+}
+
+template<typename Key, typename Value>
+CompactAVLTree<Key, Value>::CompactAVLTree() : root_(NIL), count_(0)
+{
+
+}
+
+template<typename Key, typename Value>
+bool CompactAVLTree<Key, Value>::empty() const
+{
+    return root_ == NIL;
+}
+
+template<typename Key, typename Value>
+size_t CompactAVLTree<Key, Value>::size() const
+{
+    return count_;
+}
+
+/**
+* Drops every item and releases the node array.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::clear()
+{
+    std::vector<CompactNode>().swap(nodes_);
+    std::vector<Index>().swap(free_);
+    root_ = NIL;
+    count_ = 0;
+}
+
+/**
+* Grows the node array up front so that count inserts do not reallocate.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::reserve(size_t count)
+{
+    nodes_.reserve(count);
+}
+
+/**
+* Bytes held by the node array and the free list, spare capacity included.
+*/
+template<typename Key, typename Value>
+size_t CompactAVLTree<Key, Value>::memoryUsage() const
+{
+    return nodes_.capacity() * sizeof(CompactNode) + free_.capacity() * sizeof(Index);
+}
+
+/**
+* Renumbers the live nodes in the given order into an array of exactly
+* their size, which drops the slots freed by removes and any spare
+* capacity. Iterators do not survive it.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::compact(CompactOrder order)
+{
+    std::vector<Index> sequence;
+    sequence.reserve(count_);
+    if(order == COMPACT_VEB){
+        bool balanced = true;
+        vebOrder(root_, checkBalanced(root_, balanced), sequence);
+    }
+    else{
+        Index current = begin().current_;
+        while(current != NIL){
+            sequence.push_back(current);
+            current = successor(current);
+        }
+    }
+
+    std::vector<Index> renumber(nodes_.size(), NIL);
+    for(size_t i = 0; i < sequence.size(); i++){
+        renumber[sequence[i]] = (Index)i;
+    }
+    std::vector<CompactNode> packed;
+    packed.reserve(sequence.size());
+    for(size_t i = 0; i < sequence.size(); i++){
+        packed.push_back(nodes_[sequence[i]]);
+        CompactNode& node = packed.back();
+        node.parent = (node.parent == NIL) ? NIL : renumber[node.parent];
+        node.left = (node.left == NIL) ? NIL : renumber[node.left];
+        node.right = (node.right == NIL) ? NIL : renumber[node.right];
+    }
+
+    root_ = (root_ == NIL) ? NIL : renumber[root_];
+    nodes_.swap(packed);
+    std::vector<Index>().swap(free_);
+}
+
+/**
+* Appends the nodes of root's subtree less than height levels down in van
+* Emde Boas order, as BinarySearchTree::vebOrder does for pointer trees.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::vebOrder(Index root, int height, std::vector<Index>& out) const
+{
+    if(root == NIL || height <= 0){
+        return;
+    }
+    if(height == 1){
+        out.push_back(root);
+        return;
+    }
+
+    int top = height / 2;
+    vebOrder(root, top, out);
+    std::vector<Index> bottoms;
+    collectDepth(root, top, bottoms);
+    for(size_t i = 0; i < bottoms.size(); i++){
+        vebOrder(bottoms[i], height - top, out);
+    }
+}
+
+/**
+* Appends the nodes exactly depth levels below root, left to right.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::collectDepth(Index root, int depth, std::vector<Index>& out) const
+{
+    if(root == NIL){
+        return;
+    }
+    if(depth == 0){
+        out.push_back(root);
+        return;
+    }
+    collectDepth(nodes_[root].left, depth - 1, out);
+    collectDepth(nodes_[root].right, depth - 1, out);
+}
+
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::iterator CompactAVLTree<Key, Value>::begin() const
+{
+    Index current = root_;
+    if(current != NIL){
+        while(nodes_[current].left != NIL){
+            current = nodes_[current].left;
+        }
+    }
+    return iterator(const_cast<CompactAVLTree<Key, Value>*>(this), current);
+}
+
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::iterator CompactAVLTree<Key, Value>::end() const
+{
+    return iterator(const_cast<CompactAVLTree<Key, Value>*>(this), NIL);
+}
+
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::iterator CompactAVLTree<Key, Value>::find(const Key& key) const
+{
+    return iterator(const_cast<CompactAVLTree<Key, Value>*>(this), internalFind(key));
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value associated with the key
+*/
+template<typename Key, typename Value>
+Value& CompactAVLTree<Key, Value>::operator[](const Key& key)
+{
+    Index current = internalFind(key);
+    if(current == NIL) throw std::out_of_range("Invalid key");
+    return nodes_[current].item.second;
+}
+
+template<typename Key, typename Value>
+Value const & CompactAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    Index current = internalFind(key);
+    if(current == NIL) throw std::out_of_range("Invalid key");
+    return nodes_[current].item.second;
+}
+
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::Index CompactAVLTree<Key, Value>::internalFind(const Key& key) const
+{
+    Index current = root_;
+    while(current != NIL){
+        const CompactNode& node = nodes_[current];
+        if(key < node.item.first){
+            current = node.left;
+        }
+        else if(node.item.first < key){
+            current = node.right;
+        }
+        else{
+            return current;
+        }
+    }
+    return NIL;
+}
+
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::Index CompactAVLTree<Key, Value>::successor(Index current) const
+{
+    if(current == NIL){
+        return NIL;
+    }
+    if(nodes_[current].right != NIL){
+        current = nodes_[current].right;
+        while(nodes_[current].left != NIL){
+            current = nodes_[current].left;
+        }
+        return current;
+    }
+    Index parent = nodes_[current].parent;
+    while(parent != NIL && nodes_[parent].right == current){
+        current = parent;
+        parent = nodes_[parent].parent;
+    }
+    return parent;
+}
+
+/**
+* Takes a slot from the free list, or appends one to the array.
+*/
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::Index CompactAVLTree<Key, Value>::allocateNode(const Key& key, const Value& value, Index parent)
+{
+    if(!free_.empty()){
+        Index slot = free_.back();
+        free_.pop_back();
+        new (&nodes_[slot]) CompactNode(key, value, parent);
+        return slot;
+    }
+    if(nodes_.size() >= (size_t)NIL){
+        throw std::length_error("CompactAVLTree is full");
+    }
+    nodes_.push_back(CompactNode(key, value, parent));
+    return (Index)(nodes_.size() - 1);
+}
+
+/**
+* Points parent (or the root, for NIL) at newChild instead of oldChild.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::replaceChild(Index parent, Index oldChild, Index newChild)
+{
+    if(parent == NIL){
+        root_ = newChild;
+    }
+    else if(nodes_[parent].left == oldChild){
+        nodes_[parent].left = newChild;
+    }
+    else{
+        nodes_[parent].right = newChild;
+    }
+    if(newChild != NIL){
+        nodes_[newChild].parent = parent;
+    }
+}
+
+/**
+* Rotates n1 down to the left, updating the two balances in O(1) like
+* AVLTree::rotateLeftAt, and returns the node that took its place.
+*/
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::Index CompactAVLTree<Key, Value>::rotateLeftAt(Index n1)
+{
+    Index n2 = nodes_[n1].right;
+    Index moved = nodes_[n2].left;
+
+    replaceChild(nodes_[n1].parent, n1, n2);
+    nodes_[n1].right = moved;
+    if(moved != NIL){
+        nodes_[moved].parent = n1;
+    }
+    nodes_[n2].left = n1;
+    nodes_[n1].parent = n2;
+
+    int b1 = nodes_[n1].balance;
+    int b2 = nodes_[n2].balance;
+    b1 = b1 - 1 - std::max(b2, 0);
+    b2 = b2 - 1 + std::min(b1, 0);
+    nodes_[n1].balance = (int8_t)b1;
+    nodes_[n2].balance = (int8_t)b2;
+    return n2;
+}
+
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::Index CompactAVLTree<Key, Value>::rotateRightAt(Index n1)
+{
+    Index n2 = nodes_[n1].left;
+    Index moved = nodes_[n2].right;
+
+    replaceChild(nodes_[n1].parent, n1, n2);
+    nodes_[n1].left = moved;
+    if(moved != NIL){
+        nodes_[moved].parent = n1;
+    }
+    nodes_[n2].right = n1;
+    nodes_[n1].parent = n2;
+
+    int b1 = nodes_[n1].balance;
+    int b2 = nodes_[n2].balance;
+    b1 = b1 + 1 - std::min(b2, 0);
+    b2 = b2 + 1 + std::max(b1, 0);
+    nodes_[n1].balance = (int8_t)b1;
+    nodes_[n2].balance = (int8_t)b2;
+    return n2;
+}
+
+/**
+* Fixes a node whose balance reached +-2 with a single or double rotation.
+*/
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::Index CompactAVLTree<Key, Value>::rebalanceAt(Index n1)
+{
+    if(nodes_[n1].balance > 0){
+        if(nodes_[nodes_[n1].right].balance < 0){
+            rotateRightAt(nodes_[n1].right);
+        }
+        return rotateLeftAt(n1);
+    }
+    if(nodes_[nodes_[n1].left].balance > 0){
+        rotateLeftAt(nodes_[n1].left);
+    }
+    return rotateRightAt(n1);
+}
+
+/**
+* Walks up from a freshly attached leaf, stopping as soon as a subtree
+* keeps its height; at most one (double) rotation is needed.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::retraceInsert(Index child)
+{
+    Index parent = nodes_[child].parent;
+    while(parent != NIL){
+        CompactNode& node = nodes_[parent];
+        node.balance += (node.left == child) ? -1 : 1;
+        if(node.balance == 0){
+            return;
+        }
+        if(node.balance == 2 || node.balance == -2){
+            rebalanceAt(parent);
+            return;
+        }
+        child = parent;
+        parent = node.parent;
+    }
+}
+
+/**
+* Walks up from the parent of an unlinked node. fromLeft tells which of
+* parent's subtrees got shorter.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::retraceRemove(Index parent, bool fromLeft)
+{
+    while(parent != NIL){
+        CompactNode& node = nodes_[parent];
+        node.balance += fromLeft ? 1 : -1;
+        if(node.balance == 1 || node.balance == -1){
+            return;
+        }
+        Index top = parent;
+        if(node.balance != 0){
+            Index sibling = (node.balance > 0) ? node.right : node.left;
+            int siblingBalance = nodes_[sibling].balance;
+            top = rebalanceAt(parent);
+            if(siblingBalance == 0){
+                return;
+            }
+        }
+        parent = nodes_[top].parent;
+        if(parent != NIL){
+            fromLeft = (nodes_[parent].left == top);
+        }
+    }
+}
+
+/**
+* Same contract as AVLTree::insert: an existing key gets its value overwritten.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    const Key& key = keyValuePair.first;
+    Index parent = NIL;
+    Index current = root_;
+    bool goLeft = false;
+    while(current != NIL){
+        CompactNode& node = nodes_[current];
+        if(key < node.item.first){
+            goLeft = true;
+        }
+        else if(node.item.first < key){
+            goLeft = false;
+        }
+        else{
+            node.item.second = keyValuePair.second;
+            return;
+        }
+        parent = current;
+        current = goLeft ? node.left : node.right;
+    }
+
+    Index addition = allocateNode(key, keyValuePair.second, parent);
+    if(parent == NIL){
+        root_ = addition;
+    }
+    else if(goLeft){
+        nodes_[parent].left = addition;
+    }
+    else{
+        nodes_[parent].right = addition;
+    }
+    count_++;
+    retraceInsert(addition);
+}
+
+/**
+* A node with two children is replaced by its predecessor, which is
+* relinked into its place rather than copied over it.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::remove(const Key& key)
+{
+    Index target = internalFind(key);
+    if(target == NIL){
+        return;
+    }
+
+    CompactNode& node = nodes_[target];
+    Index retraceFrom;
+    bool fromLeft;
+
+    if(node.left != NIL && node.right != NIL){
+        Index pred = node.left;
+        while(nodes_[pred].right != NIL){
+            pred = nodes_[pred].right;
+        }
+        if(nodes_[pred].parent == target){
+            retraceFrom = pred;
+            fromLeft = true;
+        }
+        else{
+            retraceFrom = nodes_[pred].parent;
+            fromLeft = false;
+            replaceChild(retraceFrom, pred, nodes_[pred].left);
+            nodes_[pred].left = node.left;
+            nodes_[node.left].parent = pred;
+        }
+        nodes_[pred].right = node.right;
+        nodes_[node.right].parent = pred;
+        nodes_[pred].balance = node.balance;
+        replaceChild(node.parent, target, pred);
+    }
+    else{
+        Index child = (node.left != NIL) ? node.left : node.right;
+        retraceFrom = node.parent;
+        fromLeft = (retraceFrom != NIL && nodes_[retraceFrom].left == target);
+        replaceChild(node.parent, target, child);
+    }
+
+    free_.push_back(target);
+    count_--;
+    if(count_ == 0){
+        clear();
+        return;
+    }
+    retraceRemove(retraceFrom, fromLeft);
+}
+
+/**
+* Checks the AVL property from the actual subtree heights.
+*/
+template<typename Key, typename Value>
+bool CompactAVLTree<Key, Value>::isBalanced() const
+{
+    bool balanced = true;
+    checkBalanced(root_, balanced);
+    return balanced;
+}
+
+template<typename Key, typename Value>
+int CompactAVLTree<Key, Value>::checkBalanced(Index root, bool& balanced) const
+{
+    if(root == NIL){
+        return 0;
+    }
+    int hl = checkBalanced(nodes_[root].left, balanced);
+    int hr = checkBalanced(nodes_[root].right, balanced);
+    if(abs(hr - hl) > 1){
+        balanced = false;
+    }
+    return std::max(hl, hr) + 1;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the CompactAVLTree class.
+  -----------------------------------------------
+*/
+
+#endif
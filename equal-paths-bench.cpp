@@ -0,0 +1,290 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <random>
+#include <chrono>
+#include <new>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "equal-paths.h"
+#include "equal-paths-iterative.h"
+#include "tree-shape.h"
+
+using namespace std;
+
+// Benchmark and stress driver for equalPaths on large generated trees.
+// Usage: ./equal-paths-bench [max n]   (default max n = 10000000)
+// Sizes run from 1000 up to max n in steps of 10.
+
+typedef chrono::steady_clock Clock;
+
+double msSince(Clock::time_point start)
+{
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// One allocation for all the nodes of a tree, freed at once. Node has no
+// destructor to run.
+class NodeBlock
+{
+public:
+    explicit NodeBlock(long count)
+        : nodes_(static_cast<Node*>(::operator new(count * sizeof(Node)))), used_(0), count_(count)
+    {
+    }
+
+    ~NodeBlock()
+    {
+        ::operator delete(nodes_);
+    }
+
+    Node* make(int key)
+    {
+        if(used_ == count_) {
+            abort();
+        }
+        return new (nodes_ + used_++) Node(key);
+    }
+
+    Node* at(long i) const
+    {
+        return nodes_ + i;
+    }
+
+    long used() const
+    {
+        return used_;
+    }
+
+private:
+    NodeBlock(const NodeBlock&);
+    NodeBlock& operator=(const NodeBlock&);
+
+    Node* nodes_;
+    long used_;
+    long count_;
+};
+
+// A heap-shaped tree of count nodes: node i has children 2i + 1 and 2i + 2.
+Node* buildComplete(NodeBlock& block, long count)
+{
+    for(long i = 0; i < count; i++) {
+        block.make((int)i);
+    }
+    for(long i = 0; 2 * i + 1 < count; i++) {
+        block.at(i)->left = block.at(2 * i + 1);
+        if(2 * i + 2 < count) {
+            block.at(i)->right = block.at(2 * i + 2);
+        }
+    }
+    return count == 0 ? NULL : block.at(0);
+}
+
+long perfectSize(long n)
+{
+    long size = 1;
+    while(2 * size + 1 <= n) {
+        size = 2 * size + 1;
+    }
+    return size;
+}
+
+Node* buildPerfect(NodeBlock& block, long n)
+{
+    return buildComplete(block, perfectSize(n));
+}
+
+// The shape of a BST grown from n random keys: the root's left subtree
+// gets a uniformly random share of the other n - 1 nodes, and so on down.
+Node* buildRandom(NodeBlock& block, long n)
+{
+    mt19937_64 rng(n);
+    Node* root = NULL;
+    vector<pair<Node**, long> > pending(1, make_pair(&root, n));
+    while(!pending.empty()) {
+        Node** slot = pending.back().first;
+        long size = pending.back().second;
+        pending.pop_back();
+        if(size == 0) {
+            continue;
+        }
+        *slot = block.make((int)block.used());
+        long leftSize = (long)(rng() % (unsigned long)size);
+        pending.push_back(make_pair(&(*slot)->right, size - 1 - leftSize));
+        pending.push_back(make_pair(&(*slot)->left, leftSize));
+    }
+    return root;
+}
+
+// Sorted inserts into a plain BST: every node is the left child of the last.
+Node* buildChain(NodeBlock& block, long n)
+{
+    Node* root = block.make(0);
+    Node* tail = root;
+    for(long i = 1; i < n; i++) {
+        tail->left = block.make((int)i);
+        tail = tail->left;
+    }
+    return root;
+}
+
+// A perfect tree whose last leaf in left-to-right order has one more child,
+// so an early exit never triggers and the answer only turns false at the end.
+Node* buildAdversarial(NodeBlock& block, long n)
+{
+    Node* root = buildComplete(block, perfectSize(n > 1 ? n - 1 : 1));
+    Node* last = root;
+    while(last->right != NULL) {
+        last = last->right;
+    }
+    last->left = block.make(-1);
+    return root;
+}
+
+struct Shape
+{
+    const char* name;
+    Node* (*build)(NodeBlock&, long);
+    int expected;   // -1 if it depends on the tree
+};
+
+struct Timing
+{
+    double ms;
+    int result;     // -1 if the run crashed
+    int signal;
+};
+
+// Runs equalPaths in a child process, so a stack overflow on a deep tree
+// is reported instead of ending the run.
+Timing timeRecursive(Node* root, int repeats)
+{
+    Timing timing = { 0.0, -1, 0 };
+    int fds[2];
+    if(pipe(fds) != 0) {
+        return timing;
+    }
+    cout.flush();
+    pid_t child = fork();
+    if(child == 0) {
+        close(fds[0]);
+        Clock::time_point start = Clock::now();
+        bool result = true;
+        for(int i = 0; i < repeats; i++) {
+            result = equalPaths(root);
+        }
+        Timing measured = { msSince(start) / repeats, result ? 1 : 0, 0 };
+        ssize_t written = write(fds[1], &measured, sizeof(measured));
+        _exit(written == (ssize_t)sizeof(measured) ? 0 : 1);
+    }
+    close(fds[1]);
+    Timing measured;
+    if(child > 0 && read(fds[0], &measured, sizeof(measured)) == (ssize_t)sizeof(measured)) {
+        timing = measured;
+    }
+    close(fds[0]);
+    int status = 0;
+    if(child > 0 && waitpid(child, &status, 0) == child && WIFSIGNALED(status)) {
+        timing.signal = WTERMSIG(status);
+    }
+    return timing;
+}
+
+Timing timeIterative(Node* root, int repeats)
+{
+    Clock::time_point start = Clock::now();
+    bool result = true;
+    for(int i = 0; i < repeats; i++) {
+        result = equalPathsIterative(root);
+    }
+    Timing timing = { msSince(start) / repeats, result ? 1 : 0, 0 };
+    return timing;
+}
+
+string describe(const Timing& t)
+{
+    if(t.result < 0) {
+        return t.signal != 0 ? "crashed" : "failed";
+    }
+    ostringstream out;
+    out << fixed << setprecision(3) << t.ms;
+    return out.str();
+}
+
+// Flags a time that grew more than 3x faster than the tree did.
+const char* growth(double ms, double previousMs, long n, long previousN)
+{
+    if(previousMs < 0.05 || ms <= 0) {
+        return "";
+    }
+    return ms / previousMs > 3.0 * n / previousN ? " superlinear" : "";
+}
+
+int main(int argc, char* argv[])
+{
+    long maxN = 10000000;
+    if(argc > 1) {
+        maxN = atol(argv[1]);
+    }
+
+    const Shape shapes[] = {
+        { "perfect", buildPerfect, 1 },
+        { "complete", buildComplete, -1 },
+        { "random", buildRandom, -1 },
+        { "chain", buildChain, 1 },
+        { "adversarial", buildAdversarial, 0 },
+    };
+
+    cout << "times in ms; recursive runs in a child process" << endl;
+    cout << left << setw(12) << "shape" << right << setw(11) << "n"
+         << setw(10) << "build" << setw(12) << "recursive" << setw(12) << "iterative"
+         << setw(9) << "ns/node" << setw(10) << "height" << "  result" << endl;
+
+    bool ok = true;
+    for(size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        const Shape& shape = shapes[s];
+        long previousN = 0;
+        Timing previousRecursive = { 0.0, -1, 0 };
+        Timing previousIterative = { 0.0, -1, 0 };
+        for(long n = 1000; n <= maxN; n *= 10) {
+            NodeBlock block(n);
+            Clock::time_point start = Clock::now();
+            Node* root = shape.build(block, n);
+            double buildMs = msSince(start);
+
+            int repeats = (int)max(1L, 1000000 / n);
+            Timing recursive = timeRecursive(root, repeats);
+            Timing iterative = timeIterative(root, repeats);
+            TreeShape analyzed = analyzeShape(root);
+
+            int expected = shape.expected >= 0 ? shape.expected : (analyzed.equalPaths() ? 1 : 0);
+            string verdict = iterative.result == expected ? (expected ? "equal" : "unequal") : "WRONG";
+            if(recursive.result >= 0 && recursive.result != expected) {
+                verdict = "WRONG";
+            }
+            if(recursive.signal != 0) {
+                verdict += " (recursive: signal " + to_string(recursive.signal) + ")";
+            }
+            if(previousN > 0) {
+                verdict += growth(recursive.ms, previousRecursive.ms, n, previousN);
+                verdict += growth(iterative.ms, previousIterative.ms, n, previousN);
+            }
+            ok = ok && verdict.find("WRONG") == string::npos;
+
+            cout << left << setw(12) << shape.name << right << setw(11) << block.used()
+                 << fixed << setprecision(1) << setw(10) << buildMs
+                 << setw(12) << describe(recursive) << setw(12) << describe(iterative)
+                 << setprecision(2) << setw(9) << iterative.ms * 1e6 / block.used()
+                 << setw(10) << analyzed.height << "  " << verdict << endl;
+
+            previousN = n;
+            previousRecursive = recursive;
+            previousIterative = iterative;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+#ifndef EQUAL_PATHS_ITERATIVE_H
+#define EQUAL_PATHS_ITERATIVE_H
+
+#include "equal-paths.h"
+
+/**
+ * @brief Same answer as equalPaths, but walks the tree with an explicit
+ *        stack instead of recursion, so trees deeper than the thread's
+ *        stack (e.g. long chains) can be checked too.
+ *
+ * @param root Pointer to the root of the tree to check for equal paths
+ */
+bool equalPathsIterative(Node * root);
+
+#endif
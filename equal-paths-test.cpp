@@ -1,6 +1,8 @@
 #include <iostream>
 #include <cstdlib>
 #include "equal-paths.h"
+#include "equal-paths-iterative.h"
+#include "tree-shape.h"
 using namespace std;
 
 
@@ -55,6 +57,89 @@ void test5(const char* msg)
   cout << msg << ": " <<   equalPaths(a) << endl;
 }
 
+void test6(const char* msg)
+{
+  // the shape of test5 with one more leaf below c: all leaves at depth 2
+  Node* g = new Node(7);
+  setNode(a,1,b,c);
+  setNode(b,2,NULL,d);
+  setNode(c,3,g,NULL);
+  setNode(d,4,NULL,NULL);
+  cout << msg << ": " <<   equalPaths(a) << " " << equalPathsIterative(a) << endl;
+  delete g;
+}
+
+void test7(const char* msg)
+{
+  // a chain far deeper than the stack allows to recurse
+  const int depth = 2000000;
+  Node* root = new Node(0);
+  Node* tail = root;
+  for(int i = 1; i < depth; i++){
+    tail->left = new Node(i);
+    tail = tail->left;
+  }
+  bool chain = equalPathsIterative(root);
+  root->right = new Node(-1);
+  bool branched = equalPathsIterative(root);
+  cout << msg << ": " << chain << " " << branched << endl;
+
+  delete root->right;
+  while(root != NULL){
+    Node* next = root->left;
+    delete root;
+    root = next;
+  }
+}
+
+void test8(const char* msg)
+{
+  // leaves at depths 2 and 1; b has only a right child
+  setNode(a,1,b,c);
+  setNode(b,2,NULL,d);
+  setNode(c,3,NULL,NULL);
+  setNode(d,4,NULL,NULL);
+  TreeShape shape = analyzeShape(a);
+  cout << msg << ": " << shape.nodes << " " << shape.height
+       << " " << shape.minLeafDepth << "-" << shape.maxLeafDepth
+       << " [" << shape.leafDepths[1] << " " << shape.leafDepths[2] << "]"
+       << " " << shape.maxHeightDifference << " " << shape.unbalancedNodes;
+
+  // a full tree of 2^16 - 1 nodes, split across the pool
+  std::vector<Node*> level(1, new Node(0));
+  Node* root = level[0];
+  for(int depth = 1; depth < 16; depth++){
+    std::vector<Node*> next;
+    for(size_t i = 0; i < level.size(); i++){
+      level[i]->left = new Node(0);
+      level[i]->right = new Node(0);
+      next.push_back(level[i]->left);
+      next.push_back(level[i]->right);
+    }
+    level.swap(next);
+  }
+  TreeShape full = analyzeShapeParallel(root);
+  cout << " | " << full.nodes << " " << full.leaves << " " << full.height
+       << " " << full.equalPaths();
+
+  // a pool of its own, so the split is taken even on one core; below
+  // minNodes the same tree is done in one pass
+  WorkStealingPool four(4);
+  TreeShape split = analyzeShapeParallel(root, four);
+  TreeShape whole = analyzeShapeParallel(root, four, 1L << 20);
+  cout << " | " << (split.nodes == full.nodes && split.leaves == full.leaves && split.height == full.height)
+       << " " << (whole.nodes == full.nodes && whole.unbalancedNodes == full.unbalancedNodes) << endl;
+
+  std::vector<Node*> stack(1, root);
+  while(!stack.empty()){
+    Node* n = stack.back();
+    stack.pop_back();
+    if(n->left) stack.push_back(n->left);
+    if(n->right) stack.push_back(n->right);
+    delete n;
+  }
+}
+
 int main()
 {
   a = new Node(1);
@@ -67,6 +152,9 @@ int main()
   test3("Test3");
   test4("Test4");
   test5("Test5");
+  test6("Test6");
+  test7("Test7");
+  test8("Test8");
  
   delete a;
   delete b;
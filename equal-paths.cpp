@@ -1,84 +1,95 @@
 #ifndef RECCHECK
 //if you want to add any #includes like <iostream> you must do them here (before the next endif)
-
+#include <vector>
+#include <utility>
 #endif
 
 #include "equal-paths.h"
+#include "equal-paths-iterative.h"
 using namespace std;
 
 
 // You may add any prototypes of helper functions here
-bool oneChild(Node * root);
-bool twoChild(Node * root);
 bool isLeaf(Node * root);
-void numVertex(Node* root, int& count);
-
+bool leafDepthsMatch(Node* root, int depth, int& leafDepth);
 
 
 
+/**
+ * One pass over the tree. The depth of the first leaf reached is kept in
+ * leafDepth and every other leaf is compared against it, so the walk stops
+ * at the first leaf (or inner node already at that depth) that cannot
+ * match. O(n), with recursion as deep as the tree; see
+ * equalPathsIterative for trees deeper than the stack.
+ */
 bool equalPaths(Node * root)
 {
     // Add your code below
 
-    if(root == NULL){
-        return true;
-    }
+    int leafDepth = -1;
+    return leafDepthsMatch(root, 0, leafDepth);
+}
 
-    if(isLeaf(root)){
+/**
+ * The same check with an explicit stack, so the depth of the tree is
+ * limited by memory rather than by the thread's stack.
+ */
+bool equalPathsIterative(Node * root)
+{
+    if(root == NULL){
         return true;
     }
 
-    if(oneChild(root)){
-        if(root->right == NULL){
-            return equalPaths(root->left);
-        }
-        else if(root->left == NULL){
-            return equalPaths(root->right);
-        }
-        //return true;
-    }
-
-    if(twoChild(root)){
-        int l = 0;
-        int r = 0;
-
-        numVertex(root->left, l);
-        numVertex(root->right, r);
-
-        if(root->left->left != NULL && root->left->right != NULL )
-            if(isLeaf(root->left->left) && !(isLeaf(root->left->right))){
+    int leafDepth = -1;
+    vector<pair<Node*, int> > stack;
+    stack.push_back(make_pair(root, 0));
+    while(!stack.empty()){
+        Node* current = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+
+        if(isLeaf(current)){
+            if(leafDepth < 0){
+                leafDepth = depth;
+            }
+            else if(depth != leafDepth){
                 return false;
             }
-        if(abs(l-r) > 1){
+            continue;
+        }
+        // an inner node at the leaf depth only has deeper leaves below it
+        if(leafDepth >= 0 && depth >= leafDepth){
             return false;
         }
-        else{
-            return true;
+        if(current->right != NULL){
+            stack.push_back(make_pair(current->right, depth + 1));
+        }
+        if(current->left != NULL){
+            stack.push_back(make_pair(current->left, depth + 1));
         }
     }
+    return true;
 }
 
-bool oneChild(Node* root){
-    if(root -> right == NULL && root->left != NULL){
-        return true;
-    }
-    else if(root->left == NULL && root->right != NULL){
+bool leafDepthsMatch(Node* root, int depth, int& leafDepth){
+    if(root == NULL){
         return true;
     }
 
-    else{
-        return false;
-    }
-}
-
-bool twoChild(Node* root){
-    if(root->left != NULL && root->right != NULL){
-        return true;
+    if(isLeaf(root)){
+        if(leafDepth < 0){
+            leafDepth = depth;
+        }
+        return depth == leafDepth;
     }
 
-    else{
+    // an inner node at the leaf depth only has deeper leaves below it
+    if(leafDepth >= 0 && depth >= leafDepth){
         return false;
     }
+
+    return leafDepthsMatch(root->left, depth + 1, leafDepth)
+        && leafDepthsMatch(root->right, depth + 1, leafDepth);
 }
 
 bool isLeaf(Node* root){
@@ -90,16 +101,3 @@ bool isLeaf(Node* root){
     }
 }
 
-void numVertex(Node* root, int& count){
-    if(root == NULL){
-        return;
-    }
-
-    else{
-        numVertex(root->left, count);
-        numVertex(root->right, count);
-        count++;
-    }
-
-}
-
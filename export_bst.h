@@ -0,0 +1,439 @@
+#ifndef EXPORT_BST_H
+#define EXPORT_BST_H
+
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include "bst.h"
+
+// Streaming tree export, for trees far too big for printRoot.
+//
+// The tree is written in one pre-order pass straight to the stream; the
+// only memory used is a stack of the written nodes on the current path.
+// Two windows limit what is written:
+//
+//  - maxDepth: nodes below that level are left out. A written node whose
+//    children were left out for it is marked "cut".
+//  - [low, high]: only nodes with keys in the range are written. The walk
+//    only enters subtrees that can hold such keys, and every written node
+//    is linked to its nearest written ancestor; where that skips nodes
+//    outside the range the link is marked "skipped".
+//
+// Formats:
+//
+//  EXPORT_DOT     digraph for Graphviz. Nodes are n<pre-order number>,
+//                 labelled with the key; edges are labelled L or R. Cut
+//                 nodes are boxes, skipped links are dashed.
+//  EXPORT_JSON    nested objects {"key":..,"value":..,"left":..,"right":..}
+//                 with "cut":true / "skipped":true where they apply, or null
+//                 for an empty window.
+//  EXPORT_BINARY  the bytes "BST1", then per node in pre-order: a flags
+//                 byte (1: left child follows, 2: right child follows,
+//                 4: cut, 8: skipped), the key and the value. Arithmetic
+//                 keys and values are stored as their raw bytes in host
+//                 byte order, anything else as a uint32 length and the
+//                 text operator<< writes for it.
+//
+// Keys and values need operator<< unless they are arithmetic.
+
+namespace exportbst {
+
+/**
+* Output is gathered here and handed to the stream in blocks, which keeps
+* the per-node cost of a 10M-node export down to formatting the node.
+*/
+class Buffer
+{
+public:
+    explicit Buffer(std::ostream& out) : out_(out)
+    {
+        text_.reserve(BLOCK + 256);
+    }
+
+    ~Buffer()
+    {
+        flush();
+    }
+
+    void append(const char* text)
+    {
+        text_ += text;
+    }
+
+    void append(char c)
+    {
+        text_ += c;
+    }
+
+    void appendRaw(const void* data, size_t bytes)
+    {
+        text_.append(static_cast<const char*>(data), bytes);
+    }
+
+    void appendNumber(unsigned long long value)
+    {
+        char digits[24];
+        int count = 0;
+        do{
+            digits[count++] = (char)('0' + value % 10);
+            value /= 10;
+        } while(value != 0);
+        while(count > 0){
+            text_ += digits[--count];
+        }
+    }
+
+    // Integers are written here directly, anything else through
+    // operator<<, escaped for a JSON or DOT string.
+    template<typename T>
+    void appendText(const T& value)
+    {
+        appendText(value, std::is_integral<T>());
+    }
+
+    void endNode()
+    {
+        if(text_.size() >= BLOCK){
+            flush();
+        }
+    }
+
+private:
+    static const size_t BLOCK = 1 << 16;
+
+    template<typename T>
+    void appendText(const T& value, std::true_type)
+    {
+        if(value < 0){
+            text_ += '-';
+            appendNumber(0ULL - (unsigned long long)value);
+        }
+        else{
+            appendNumber((unsigned long long)value);
+        }
+    }
+
+    template<typename T>
+    void appendText(const T& value, std::false_type)
+    {
+        std::ostringstream text;
+        text.precision(std::numeric_limits<long double>::max_digits10);
+        text << value;
+        const std::string& raw = text.str();
+        for(size_t i = 0; i < raw.size(); i++){
+            unsigned char c = raw[i];
+            if(c == '"' || c == '\\'){
+                text_ += '\\';
+                text_ += (char)c;
+            }
+            else if(c < 0x20){
+                static const char hex[] = "0123456789abcdef";
+                text_ += "\\u00";
+                text_ += hex[c >> 4];
+                text_ += hex[c & 15];
+            }
+            else{
+                text_ += (char)c;
+            }
+        }
+    }
+
+    void flush()
+    {
+        out_.write(text_.data(), text_.size());
+        text_.clear();
+    }
+
+    std::ostream& out_;
+    std::string text_;
+};
+
+/**
+* One written node, as the walk hands it to a writer.
+*/
+template<typename Key, typename Value>
+struct Visit
+{
+    const Node<Key, Value>* node;
+    unsigned long id;
+    unsigned long parentId;     // meaningless for the first node
+    bool root;
+    bool right;                 // right child of its written parent
+    bool skipped;
+    bool cut;
+    bool hasLeft;
+    bool hasRight;
+};
+
+// Every writer gets open() for a node, then whatever its left child
+// writes (or absent()), middle(), the right child (or absent()), close().
+
+template<typename Key, typename Value>
+class DotWriter
+{
+public:
+    explicit DotWriter(std::ostream& out) : buffer_(out)
+    {
+        buffer_.append("digraph bst {\n  node [shape=circle];\n");
+    }
+
+    ~DotWriter()
+    {
+        buffer_.append("}\n");
+    }
+
+    void open(const Visit<Key, Value>& v)
+    {
+        buffer_.append("  n");
+        buffer_.appendNumber(v.id);
+        buffer_.append(" [label=\"");
+        buffer_.appendText(v.node->getKey());
+        buffer_.append(v.cut ? "\", shape=box];\n" : "\"];\n");
+        if(!v.root){
+            buffer_.append("  n");
+            buffer_.appendNumber(v.parentId);
+            buffer_.append(" -> n");
+            buffer_.appendNumber(v.id);
+            buffer_.append(v.right ? " [label=\"R\"" : " [label=\"L\"");
+            buffer_.append(v.skipped ? ", style=dashed];\n" : "];\n");
+        }
+        buffer_.endNode();
+    }
+    void absent() { }
+    void middle() { }
+    void close() { }
+
+private:
+    Buffer buffer_;
+};
+
+template<typename Key, typename Value>
+class JsonWriter
+{
+public:
+    explicit JsonWriter(std::ostream& out) : buffer_(out), empty_(true)
+    {
+    }
+
+    ~JsonWriter()
+    {
+        buffer_.append(empty_ ? "null\n" : "\n");
+    }
+
+    void open(const Visit<Key, Value>& v)
+    {
+        empty_ = false;
+        buffer_.append("{\"key\":");
+        appendJson(v.node->getKey());
+        buffer_.append(",\"value\":");
+        appendJson(v.node->getValue());
+        if(v.cut){
+            buffer_.append(",\"cut\":true");
+        }
+        if(v.skipped){
+            buffer_.append(",\"skipped\":true");
+        }
+        buffer_.append(",\"left\":");
+    }
+    void absent() { buffer_.append("null"); }
+    void middle() { buffer_.append(",\"right\":"); }
+    void close() { buffer_.append('}'); buffer_.endNode(); }
+
+private:
+    template<typename T>
+    void appendJson(const T& value)
+    {
+        const bool number = std::is_arithmetic<T>::value;
+        if(!number){
+            buffer_.append('"');
+        }
+        buffer_.appendText(value);
+        if(!number){
+            buffer_.append('"');
+        }
+    }
+
+    Buffer buffer_;
+    bool empty_;
+};
+
+template<typename Key, typename Value>
+class BinaryWriter
+{
+public:
+    explicit BinaryWriter(std::ostream& out) : buffer_(out)
+    {
+        buffer_.append("BST1");
+    }
+
+    void open(const Visit<Key, Value>& v)
+    {
+        char flags = (char)((v.hasLeft ? 1 : 0) | (v.hasRight ? 2 : 0) | (v.cut ? 4 : 0) | (v.skipped ? 8 : 0));
+        buffer_.append(flags);
+        appendField(v.node->getKey(), std::is_arithmetic<Key>());
+        appendField(v.node->getValue(), std::is_arithmetic<Value>());
+        buffer_.endNode();
+    }
+    void absent() { }
+    void middle() { }
+    void close() { }
+
+private:
+    template<typename T>
+    void appendField(const T& value, std::true_type)
+    {
+        buffer_.appendRaw(&value, sizeof(value));
+    }
+
+    template<typename T>
+    void appendField(const T& value, std::false_type)
+    {
+        std::ostringstream text;
+        text << value;
+        const std::string& raw = text.str();
+        uint32_t length = (uint32_t)raw.size();
+        buffer_.appendRaw(&length, sizeof(length));
+        buffer_.appendRaw(raw.data(), length);
+    }
+
+    Buffer buffer_;
+};
+
+}
+
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::exportTree(std::ostream& out, ExportFormat format, int maxDepth) const
+{
+    if(format == EXPORT_DOT){
+        exportbst::DotWriter<Key, Value> writer(out);
+        exportNodes(writer, NULL, NULL, maxDepth);
+    }
+    else if(format == EXPORT_JSON){
+        exportbst::JsonWriter<Key, Value> writer(out);
+        exportNodes(writer, NULL, NULL, maxDepth);
+    }
+    else{
+        exportbst::BinaryWriter<Key, Value> writer(out);
+        exportNodes(writer, NULL, NULL, maxDepth);
+    }
+}
+
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::exportTree(std::ostream& out, ExportFormat format, const Key& low, const Key& high, int maxDepth) const
+{
+    if(format == EXPORT_DOT){
+        exportbst::DotWriter<Key, Value> writer(out);
+        exportNodes(writer, &low, &high, maxDepth);
+    }
+    else if(format == EXPORT_JSON){
+        exportbst::JsonWriter<Key, Value> writer(out);
+        exportNodes(writer, &low, &high, maxDepth);
+    }
+    else{
+        exportbst::BinaryWriter<Key, Value> writer(out);
+        exportNodes(writer, &low, &high, maxDepth);
+    }
+}
+
+/**
+* The walk behind exportTree. Below a written node, nodes outside the key
+* window are passed over: since they hold keys on one side of the window,
+* only one of their subtrees can hold written nodes, so each side of a
+* written node leads to at most one written child.
+*/
+template<class Key, class Value>
+template<typename Writer>
+void BinarySearchTree<Key, Value>::exportNodes(Writer& writer, const Key* low, const Key* high, int maxDepth) const
+{
+    struct Stop
+    {
+        Node<Key, Value>* node;
+        int depth;
+        bool skipped;
+    };
+    struct Frame
+    {
+        exportbst::Visit<Key, Value> visit;
+        Stop left;
+        Stop right;
+        int stage;
+    };
+
+    // first node at or below node that is inside both windows
+    auto settle = [&](Node<Key, Value>* node, int depth) {
+        Stop stop = { node, depth, false };
+        while(stop.node != NULL && (maxDepth < 0 || stop.depth <= maxDepth)){
+            if(low != NULL && stop.node->getKey() < *low){
+                stop.node = stop.node->getRight();
+            }
+            else if(high != NULL && *high < stop.node->getKey()){
+                stop.node = stop.node->getLeft();
+            }
+            else{
+                return stop;
+            }
+            stop.depth++;
+            stop.skipped = true;
+        }
+        stop.node = NULL;
+        return stop;
+    };
+
+    unsigned long nextId = 0;
+    std::vector<Frame> stack;
+    auto push = [&](const Stop& stop, unsigned long parentId, bool root, bool right) {
+        Frame frame;
+        Node<Key, Value>* node = stop.node;
+        frame.left = settle(node->getLeft(), stop.depth + 1);
+        frame.right = settle(node->getRight(), stop.depth + 1);
+        frame.stage = 0;
+        exportbst::Visit<Key, Value> visit = {
+            node, nextId++, parentId, root, right, stop.skipped && !root,
+            maxDepth >= 0 && stop.depth == maxDepth && (node->getLeft() != NULL || node->getRight() != NULL),
+            frame.left.node != NULL, frame.right.node != NULL
+        };
+        frame.visit = visit;
+        writer.open(frame.visit);
+        stack.push_back(frame);
+    };
+
+    Stop top = settle(root_, 0);
+    if(top.node == NULL){
+        return;
+    }
+    push(top, 0, true, false);
+    while(!stack.empty()){
+        Frame& frame = stack.back();
+        if(frame.stage == 0){
+            frame.stage = 1;
+            if(frame.left.node != NULL){
+                Stop left = frame.left;
+                push(left, frame.visit.id, false, false);
+            }
+            else{
+                writer.absent();
+            }
+        }
+        else if(frame.stage == 1){
+            frame.stage = 2;
+            writer.middle();
+            if(frame.right.node != NULL){
+                Stop right = frame.right;
+                push(right, frame.visit.id, false, true);
+            }
+            else{
+                writer.absent();
+            }
+        }
+        else{
+            writer.close();
+            stack.pop_back();
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,293 @@
+#ifndef HASHINDEX_H
+#define HASHINDEX_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <functional>
+#include "bst.h"
+#include "avlbst.h"
+
+/**
+* An open addressing hash table from key to tree node, with linear
+* probing and backward shift deletion (no tombstones). Each slot keeps the
+* mixed hash next to the node pointer, so a probe only dereferences a node
+* whose hash matches. The table grows at 3/4 full.
+*/
+template <class Key, class Value, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key> >
+class NodeHashIndex
+{
+public:
+    NodeHashIndex();
+
+    Node<Key, Value>* get(const Key& key) const;
+    void put(Node<Key, Value>* node);
+    void erase(const Key& key);
+    void clear();
+    size_t size() const;
+    size_t memoryUsage() const;
+
+private:
+    struct Slot
+    {
+        size_t hash;
+        Node<Key, Value>* node;
+    };
+
+    size_t mix(const Key& key) const;
+    size_t slotOf(const Key& key, size_t hash) const;
+    void grow();
+
+    std::vector<Slot> slots_;
+    size_t count_;
+    Hash hash_;
+    KeyEqual equal_;
+};
+
+template<class Key, class Value, class Hash, class KeyEqual>
+NodeHashIndex<Key, Value, Hash, KeyEqual>::NodeHashIndex() : count_(0)
+{
+
+}
+
+/**
+* std::hash is the identity for integers, and the low bits pick the
+* slot, so the bits are spread first (the 64-bit murmur finalizer).
+*/
+template<class Key, class Value, class Hash, class KeyEqual>
+size_t NodeHashIndex<Key, Value, Hash, KeyEqual>::mix(const Key& key) const
+{
+    uint64_t h = hash_(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (size_t)h;
+}
+
+/**
+* Index of the slot holding key, or of the empty slot that ends its probe
+* sequence. The table must not be empty.
+*/
+template<class Key, class Value, class Hash, class KeyEqual>
+size_t NodeHashIndex<Key, Value, Hash, KeyEqual>::slotOf(const Key& key, size_t hash) const
+{
+    size_t mask = slots_.size() - 1;
+    size_t i = hash & mask;
+    while(slots_[i].node != NULL){
+        if(slots_[i].hash == hash && equal_(slots_[i].node->getKey(), key)){
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+template<class Key, class Value, class Hash, class KeyEqual>
+Node<Key, Value>* NodeHashIndex<Key, Value, Hash, KeyEqual>::get(const Key& key) const
+{
+    if(count_ == 0){
+        return NULL;
+    }
+    return slots_[slotOf(key, mix(key))].node;
+}
+
+/**
+* Indexes node under its key, replacing any node indexed under that key.
+*/
+template<class Key, class Value, class Hash, class KeyEqual>
+void NodeHashIndex<Key, Value, Hash, KeyEqual>::put(Node<Key, Value>* node)
+{
+    if((count_ + 1) * 4 > slots_.size() * 3){
+        grow();
+    }
+    size_t hash = mix(node->getKey());
+    size_t i = slotOf(node->getKey(), hash);
+    if(slots_[i].node == NULL){
+        count_++;
+    }
+    slots_[i].hash = hash;
+    slots_[i].node = node;
+}
+
+/**
+* Removes key, then pulls later entries of the probe run back into the
+* hole whenever that does not move them before their home slot.
+*/
+template<class Key, class Value, class Hash, class KeyEqual>
+void NodeHashIndex<Key, Value, Hash, KeyEqual>::erase(const Key& key)
+{
+    if(count_ == 0){
+        return;
+    }
+    size_t i = slotOf(key, mix(key));
+    if(slots_[i].node == NULL){
+        return;
+    }
+
+    size_t mask = slots_.size() - 1;
+    size_t j = i;
+    while(true){
+        j = (j + 1) & mask;
+        if(slots_[j].node == NULL){
+            break;
+        }
+        size_t home = slots_[j].hash & mask;
+        // slot j may move to i only if its home is not in (i, j] cyclically
+        bool between = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if(!between){
+            slots_[i] = slots_[j];
+            i = j;
+        }
+    }
+    slots_[i].node = NULL;
+    count_--;
+}
+
+template<class Key, class Value, class Hash, class KeyEqual>
+void NodeHashIndex<Key, Value, Hash, KeyEqual>::clear()
+{
+    slots_.clear();
+    count_ = 0;
+}
+
+template<class Key, class Value, class Hash, class KeyEqual>
+size_t NodeHashIndex<Key, Value, Hash, KeyEqual>::size() const
+{
+    return count_;
+}
+
+template<class Key, class Value, class Hash, class KeyEqual>
+size_t NodeHashIndex<Key, Value, Hash, KeyEqual>::memoryUsage() const
+{
+    return slots_.capacity() * sizeof(Slot);
+}
+
+template<class Key, class Value, class Hash, class KeyEqual>
+void NodeHashIndex<Key, Value, Hash, KeyEqual>::grow()
+{
+    std::vector<Slot> old;
+    old.swap(slots_);
+    Slot empty = { 0, NULL };
+    slots_.assign(old.empty() ? 16 : old.size() * 2, empty);
+
+    size_t mask = slots_.size() - 1;
+    for(size_t k = 0; k < old.size(); k++){
+        if(old[k].node != NULL){
+            size_t i = old[k].hash & mask;
+            while(slots_[i].node != NULL){
+                i = (i + 1) & mask;
+            }
+            slots_[i] = old[k];
+        }
+    }
+}
+
+/**
+* A search tree with a hash index on the side: find and operator[] are
+* O(1) expected, while iteration, successor and range scans still follow
+* the tree. Tree is the engine to wrap (AVLTree by default; any
+* BinarySearchTree with unique keys works), so only users who ask for the
+* index pay for it.
+*
+* The index is updated in insert and remove, and when relocateStep moves
+* a node. nodeSwap needs nothing: it moves nodes, and each node keeps its
+* key, so key -> node stays right. clear, compact and the batch
+* operations, which free or replace nodes wholesale, all end in
+* refreshEnds, which rebuilds the index here; so they stay safe when
+* called through a reference to the engine or to BinarySearchTree.
+*/
+template <class Key, class Value, class Tree = AVLTree<Key, Value>,
+          class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key> >
+class HashIndexedTree : public Tree
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    virtual void remove(const Key& key);
+    using Tree::remove;
+
+    virtual size_t memoryUsage() const;
+
+protected:
+    virtual Node<Key, Value>* insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item);
+    virtual void nodeMoved(Node<Key, Value>* from, Node<Key, Value>* to);
+    virtual Node<Key, Value>* lookupNode(const Key& key) const;
+    virtual void refreshEnds();
+    void rebuildIndex();
+
+    NodeHashIndex<Key, Value, Hash, KeyEqual> index_;
+};
+
+/*
+ * The engine's insertFrom does the work and hands back the node, so
+ * indexing a new key needs no second search.
+ */
+template<class Key, class Value, class Tree, class Hash, class KeyEqual>
+Node<Key, Value>* HashIndexedTree<Key, Value, Tree, Hash, KeyEqual>::insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item)
+{
+    bool indexed = (index_.get(new_item.first) != NULL);
+    Node<Key, Value>* node = Tree::insertFrom(start, new_item);
+    if(!indexed){
+        index_.put(node);
+    }
+    return node;
+}
+
+template<class Key, class Value, class Tree, class Hash, class KeyEqual>
+void HashIndexedTree<Key, Value, Tree, Hash, KeyEqual>::remove(const Key& key)
+{
+    if(index_.get(key) == NULL){
+        return;
+    }
+    index_.erase(key);
+    Tree::remove(key);
+}
+
+/**
+* find and operator[] come here, through whichever type they are called,
+* and skip the descent.
+*/
+template<class Key, class Value, class Tree, class Hash, class KeyEqual>
+Node<Key, Value>* HashIndexedTree<Key, Value, Tree, Hash, KeyEqual>::lookupNode(const Key& key) const
+{
+    return index_.get(key);
+}
+
+template<class Key, class Value, class Tree, class Hash, class KeyEqual>
+size_t HashIndexedTree<Key, Value, Tree, Hash, KeyEqual>::memoryUsage() const
+{
+    return Tree::memoryUsage() + index_.memoryUsage();
+}
+
+template<class Key, class Value, class Tree, class Hash, class KeyEqual>
+void HashIndexedTree<Key, Value, Tree, Hash, KeyEqual>::nodeMoved(Node<Key, Value>* from, Node<Key, Value>* to)
+{
+    Tree::nodeMoved(from, to);
+    index_.put(to);
+}
+
+/**
+* Every bulk change ends here, including clear on an emptied tree, so the
+* index never holds a node that was freed or replaced.
+*/
+template<class Key, class Value, class Tree, class Hash, class KeyEqual>
+void HashIndexedTree<Key, Value, Tree, Hash, KeyEqual>::refreshEnds()
+{
+    Tree::refreshEnds();
+    rebuildIndex();
+}
+
+template<class Key, class Value, class Tree, class Hash, class KeyEqual>
+void HashIndexedTree<Key, Value, Tree, Hash, KeyEqual>::rebuildIndex()
+{
+    index_.clear();
+    for(iterator it = this->begin(); it != this->end(); ++it){
+        index_.put(it.current_);
+    }
+}
+
+#endif
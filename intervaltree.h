@@ -0,0 +1,144 @@
+#ifndef INTERVALTREE_H
+#define INTERVALTREE_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+#include "augmentedavl.h"
+
+/**
+* A half open interval [start, end). Intervals are ordered by start, then
+* by end, so they can be the keys of a tree.
+*/
+template <typename Point>
+struct Interval
+{
+    Interval() : start(), end() { }
+    Interval(const Point& s, const Point& e) : start(s), end(e) { }
+
+    bool operator<(const Interval& rhs) const
+    {
+        return start < rhs.start || (!(rhs.start < start) && end < rhs.end);
+    }
+    bool operator==(const Interval& rhs) const
+    {
+        return !(*this < rhs) && !(rhs < *this);
+    }
+
+    Point start;
+    Point end;
+};
+
+template <typename Point>
+std::ostream& operator<<(std::ostream& out, const Interval<Point>& interval)
+{
+    return out << "[" << interval.start << ", " << interval.end << ")";
+}
+
+/**
+* Largest end point in a subtree.
+*/
+template <class Point, class Value>
+struct MaxEnd
+{
+    typedef Point type;
+    type identity() const { return std::numeric_limits<Point>::lowest(); }
+    type lift(const Interval<Point>& key, const Value&) const { return key.end; }
+    type combine(const type& a, const type& b) const { return (a < b) ? b : a; }
+};
+
+/**
+* An interval tree: an AVL tree keyed by interval that keeps the largest
+* end point of every subtree, so a query can skip any subtree that ends
+* before it. Each interval is stored once, with a value; inserting the
+* same interval again overwrites the value.
+*
+* Queries report matches in key order by calling visit with the item
+* (std::pair<const Interval<Point>, Value>&); nothing is allocated. They
+* only walk the search paths to the matches, plus the boundary of the
+* query, so k matches cost O(log n + k log(n/k)) and clustered matches,
+* the usual case, are close to O(log n + k).
+*/
+template <class Point, class Value>
+class IntervalTree : public AugmentedAVLTree<Interval<Point>, Value, MaxEnd<Point, Value> >
+{
+public:
+    typedef AugmentedAVLTree<Interval<Point>, Value, MaxEnd<Point, Value> > Base;
+
+    void insert(const Point& start, const Point& end, const Value& value);
+    using AVLTree<Interval<Point>, Value>::insert;
+    void remove(const Point& start, const Point& end);
+    using AVLTree<Interval<Point>, Value>::remove;
+
+    template<typename Visitor>
+    void stabbing(const Point& point, Visitor visit) const;
+    template<typename Visitor>
+    void overlapping(const Point& lo, const Point& hi, Visitor visit) const;
+
+protected:
+    template<typename Visitor>
+    void collect(typename Base::AugNode* node, const Point& lo, const Point& hi, bool closed, Visitor& visit) const;
+};
+
+template<class Point, class Value>
+void IntervalTree<Point, Value>::insert(const Point& start, const Point& end, const Value& value)
+{
+    this->insert(std::make_pair(Interval<Point>(start, end), value));
+}
+
+template<class Point, class Value>
+void IntervalTree<Point, Value>::remove(const Point& start, const Point& end)
+{
+    this->remove(Interval<Point>(start, end));
+}
+
+/**
+* Visits every interval that contains point: start <= point < end.
+*/
+template<class Point, class Value>
+template<typename Visitor>
+void IntervalTree<Point, Value>::stabbing(const Point& point, Visitor visit) const
+{
+    collect(static_cast<typename Base::AugNode*>(this->root_), point, point, true, visit);
+}
+
+/**
+* Visits every interval that overlaps [lo, hi): start < hi and lo < end.
+*/
+template<class Point, class Value>
+template<typename Visitor>
+void IntervalTree<Point, Value>::overlapping(const Point& lo, const Point& hi, Visitor visit) const
+{
+    collect(static_cast<typename Base::AugNode*>(this->root_), lo, hi, false, visit);
+}
+
+/**
+* Visits, in order, the intervals in node's subtree with end > lo and
+* start < hi (start <= hi if closed). A subtree whose largest end is not
+* above lo has no match, and nothing right of a node starting past hi
+* can match.
+*/
+template<class Point, class Value>
+template<typename Visitor>
+void IntervalTree<Point, Value>::collect(typename Base::AugNode* node, const Point& lo, const Point& hi, bool closed, Visitor& visit) const
+{
+    if(node == NULL || !(lo < node->getAggregate())){
+        return;
+    }
+
+    collect(node->getLeft(), lo, hi, closed, visit);
+
+    const Interval<Point>& interval = node->getKey();
+    bool startsInside = closed ? !(hi < interval.start) : (interval.start < hi);
+    if(!startsInside){
+        return;
+    }
+    if(lo < interval.end){
+        visit(node->getItem());
+    }
+    collect(node->getRight(), lo, hi, closed, visit);
+}
+
+#endif
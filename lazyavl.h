@@ -0,0 +1,433 @@
+#ifndef LAZYAVL_H
+#define LAZYAVL_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include "avlbst.h"
+
+/**
+* An AVL node that can be marked deleted and left in place.
+*/
+template <typename Key, typename Value>
+class LazyAVLNode : public AVLNode<Key, Value>
+{
+public:
+    LazyAVLNode(const Key& key, const Value& value);
+    virtual ~LazyAVLNode();
+
+    bool isDeleted() const;
+    void setDeleted(bool deleted);
+
+    virtual LazyAVLNode<Key, Value>* getParent() const override;
+    virtual LazyAVLNode<Key, Value>* getLeft() const override;
+    virtual LazyAVLNode<Key, Value>* getRight() const override;
+
+protected:
+    bool deleted_;      // sits in the padding after balance_
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the LazyAVLNode class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+LazyAVLNode<Key, Value>::LazyAVLNode(const Key& key, const Value& value) :
+        AVLNode<Key, Value>(key, value, NULL), deleted_(false)
+{
+
+}
+
+template<class Key, class Value>
+LazyAVLNode<Key, Value>::~LazyAVLNode()
+{
+
+}
+
+template<class Key, class Value>
+bool LazyAVLNode<Key, Value>::isDeleted() const
+{
+    return deleted_;
+}
+
+template<class Key, class Value>
+void LazyAVLNode<Key, Value>::setDeleted(bool deleted)
+{
+    deleted_ = deleted;
+}
+
+template<class Key, class Value>
+LazyAVLNode<Key, Value> *LazyAVLNode<Key, Value>::getParent() const
+{
+    return static_cast<LazyAVLNode<Key, Value>*>(this->parent_);
+}
+
+template<class Key, class Value>
+LazyAVLNode<Key, Value> *LazyAVLNode<Key, Value>::getLeft() const
+{
+    return static_cast<LazyAVLNode<Key, Value>*>(this->left_);
+}
+
+template<class Key, class Value>
+LazyAVLNode<Key, Value> *LazyAVLNode<Key, Value>::getRight() const
+{
+    return static_cast<LazyAVLNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the LazyAVLNode class.
+  -----------------------------------------------
+*/
+
+/**
+* An AVL tree with lazy deletion: remove only marks the node as a
+* tombstone, one search and no unlinking, swapping or rotations, so a
+* burst of removes does not restructure the tree under its readers.
+* Tombstones still route searches but are invisible to find,
+* operator[], iterators, scan(), size() and empty(); inserting a
+* tombstoned key brings the node back.
+*
+* The tombstones are cleared out in one of two ways:
+*  - purge() relinks the live nodes into a perfectly balanced tree and
+*    frees the rest, O(n). remove calls it once tombstones exceed
+*    purgeRatio of the nodes (a ratio of 1 or more never does).
+*  - purgeStep(budget) unlinks the tombstones among the next budget
+*    nodes in key order with the ordinary AVL remove, and picks up where
+*    it stopped on the next call, for cleanup spread over idle time.
+*
+* manyNodes counts tombstones too; size() is the number of items. The
+* batch operations purge first. Lookups, iteration, the parallel walks
+* and empty() skip tombstones through the base class hooks, so a
+* reference to AVLTree or BinarySearchTree sees the same contents; only
+* the debugging views (export, print) show them.
+*/
+template <class Key, class Value>
+class LazyAVLTree : public AVLTree<Key, Value>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+    typedef LazyAVLNode<Key, Value> LazyNode;
+
+    explicit LazyAVLTree(double purgeRatio = 0.25);
+    virtual ~LazyAVLTree();
+
+    virtual void remove(const Key& key);
+    using AVLTree<Key, Value>::remove;
+
+    virtual bool empty() const;
+    size_t size() const;
+
+    size_t tombstones() const;
+    double getPurgeRatio() const;
+    void purge();
+    bool purgeStep(size_t budget = 256);
+
+    virtual void insertBatch(const std::vector<std::pair<Key, Value> >& items, unsigned int threads = 1);
+    virtual void removeBatch(const std::vector<Key>& keys, unsigned int threads = 1);
+    virtual void buildFromUnsorted(std::vector<std::pair<Key, Value> > items,
+                                   WorkStealingPool& pool = WorkStealingPool::shared());
+
+protected:
+    virtual Node<Key, Value>* insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item);
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value);
+    virtual size_t nodeSize() const;
+    virtual Node<Key, Value>* relocateNode(Node<Key, Value>* node, NodeArena& arena);
+    virtual Node<Key, Value>* nextNode(Node<Key, Value>* node) const;
+    virtual Node<Key, Value>* previousNode(Node<Key, Value>* node) const;
+    virtual bool hiddenNode(Node<Key, Value>* node) const;
+    virtual void refreshEnds();
+
+    static bool isDead(Node<Key, Value>* node);
+    Node<Key, Value>* lowerNode(const Key& key) const;
+    AVLNode<Key, Value>* linkLive(AVLNode<Key, Value>** first, AVLNode<Key, Value>** last, int& height);
+    void endPurgePass();
+
+    double purgeRatio_;
+    size_t tombstones_;
+    Key* purgeFrom_;        // where the next purgeStep goes on, or NULL
+};
+
+template<class Key, class Value>
+LazyAVLTree<Key, Value>::LazyAVLTree(double purgeRatio) :
+        purgeRatio_(std::max(purgeRatio, 0.0)),
+        tombstones_(0),
+        purgeFrom_(NULL)
+{
+
+}
+
+template<class Key, class Value>
+LazyAVLTree<Key, Value>::~LazyAVLTree()
+{
+    endPurgePass();
+}
+
+template<class Key, class Value>
+bool LazyAVLTree<Key, Value>::isDead(Node<Key, Value>* node)
+{
+    return static_cast<LazyNode*>(node)->isDeleted();
+}
+
+template<class Key, class Value>
+size_t LazyAVLTree<Key, Value>::tombstones() const
+{
+    return tombstones_;
+}
+
+template<class Key, class Value>
+double LazyAVLTree<Key, Value>::getPurgeRatio() const
+{
+    return purgeRatio_;
+}
+
+template<class Key, class Value>
+size_t LazyAVLTree<Key, Value>::size() const
+{
+    return (size_t)this->manyNodes - tombstones_;
+}
+
+template<class Key, class Value>
+bool LazyAVLTree<Key, Value>::empty() const
+{
+    return size() == 0;
+}
+
+/*
+ * A tombstone with the key is brought back with the new value. Otherwise
+ * as AVLTree::insertFrom, sharing its search.
+ */
+template<class Key, class Value>
+Node<Key, Value>* LazyAVLTree<Key, Value>::insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item)
+{
+    Node<Key, Value>* parent;
+    Node<Key, Value>* existing = this->findInsertPoint(start, new_item.first, parent);
+    if(existing != NULL){
+        if(isDead(existing)){
+            static_cast<LazyNode*>(existing)->setDeleted(false);
+            tombstones_--;
+        }
+        existing->setValue(new_item.second);
+        this->refreshPath(static_cast<AVLNode<Key, Value>*>(existing));
+        return existing;
+    }
+
+    AVLNode<Key, Value>* addition = createNode(new_item.first, new_item.second);
+    this->attachLeaf(parent, addition);
+    this->retraceInsert(addition);
+    this->refreshPath(addition);
+    return addition;
+}
+
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::remove(const Key& key)
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if(node == NULL || isDead(node)){
+        return;
+    }
+    static_cast<LazyNode*>(node)->setDeleted(true);
+    tombstones_++;
+    if((double)tombstones_ > purgeRatio_ * this->manyNodes){
+        purge();
+    }
+}
+
+/**
+* Gathers the nodes in key order, frees the tombstones and links the rest
+* into a perfectly balanced tree. Live nodes stay where they are, so
+* iterators to them survive.
+*/
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::purge()
+{
+    endPurgePass();
+    if(tombstones_ == 0){
+        return;
+    }
+
+    std::vector<AVLNode<Key, Value>*> live;
+    std::vector<AVLNode<Key, Value>*> dead;
+    live.reserve(size());
+    dead.reserve(tombstones_);
+    std::vector<AVLNode<Key, Value>*> pending;
+    AVLNode<Key, Value>* current = static_cast<AVLNode<Key, Value>*>(this->root_);
+    while(current != NULL || !pending.empty()){
+        while(current != NULL){
+            pending.push_back(current);
+            current = current->getLeft();
+        }
+        current = pending.back();
+        pending.pop_back();
+        (isDead(current) ? dead : live).push_back(current);
+        current = current->getRight();
+    }
+    for(size_t i = 0; i < dead.size(); i++){
+        delete dead[i];
+    }
+
+    int height;
+    AVLNode<Key, Value>* root = live.empty() ? NULL : linkLive(&live[0], &live[0] + live.size(), height);
+    if(root != NULL){
+        root->setParent(NULL);
+    }
+    this->root_ = root;
+    this->manyNodes = (int)live.size();
+    tombstones_ = 0;
+    this->refreshEnds();
+}
+
+template<class Key, class Value>
+AVLNode<Key, Value>* LazyAVLTree<Key, Value>::linkLive(AVLNode<Key, Value>** first, AVLNode<Key, Value>** last, int& height)
+{
+    if(first == last){
+        height = 0;
+        return NULL;
+    }
+    AVLNode<Key, Value>** mid = first + (last - first) / 2;
+    int hl, hr;
+    AVLNode<Key, Value>* left = linkLive(first, mid, hl);
+    AVLNode<Key, Value>* right = linkLive(mid + 1, last, hr);
+    height = std::max(hl, hr) + 1;
+    return this->linkNodes(left, *mid, right, hr - hl);
+}
+
+/**
+* Looks at the next budget nodes in key order and unlinks the tombstones
+* among them. Returns true once a pass has reached the largest key; the
+* next call starts a new pass. Tombstones made behind the pass are left
+* for the next one.
+*/
+template<class Key, class Value>
+bool LazyAVLTree<Key, Value>::purgeStep(size_t budget)
+{
+    Node<Key, Value>* current = (purgeFrom_ == NULL) ? this->leftmost_ : lowerNode(*purgeFrom_);
+    for(size_t seen = 0; current != NULL && seen < budget; seen++){
+        Node<Key, Value>* next = this->successor(current);
+        if(isDead(current)){
+            this->removeNode(static_cast<AVLNode<Key, Value>*>(current));
+            tombstones_--;
+        }
+        current = next;
+    }
+
+    endPurgePass();
+    if(current == NULL){
+        return true;
+    }
+    purgeFrom_ = new Key(current->getKey());
+    return false;
+}
+
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::endPurgePass()
+{
+    delete purgeFrom_;
+    purgeFrom_ = NULL;
+}
+
+/**
+* The first node, tombstone or not, whose key is not less than key.
+*/
+template<class Key, class Value>
+Node<Key, Value>* LazyAVLTree<Key, Value>::lowerNode(const Key& key) const
+{
+    Node<Key, Value>* current = this->root_;
+    Node<Key, Value>* result = NULL;
+    while(current != NULL){
+        if(current->getKey() < key){
+            current = current->getRight();
+        }
+        else{
+            result = current;
+            current = current->getLeft();
+        }
+    }
+    return result;
+}
+
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::insertBatch(const std::vector<std::pair<Key, Value> >& items, unsigned int threads)
+{
+    purge();
+    AVLTree<Key, Value>::insertBatch(items, threads);
+}
+
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::removeBatch(const std::vector<Key>& keys, unsigned int threads)
+{
+    purge();
+    AVLTree<Key, Value>::removeBatch(keys, threads);
+}
+
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::buildFromUnsorted(std::vector<std::pair<Key, Value> > items, WorkStealingPool& pool)
+{
+    purge();
+    AVLTree<Key, Value>::buildFromUnsorted(items, pool);
+}
+
+template<class Key, class Value>
+AVLNode<Key, Value>* LazyAVLTree<Key, Value>::createNode(const Key& key, const Value& value)
+{
+    return new LazyNode(key, value);
+}
+
+template<class Key, class Value>
+size_t LazyAVLTree<Key, Value>::nodeSize() const
+{
+    return sizeof(LazyNode);
+}
+
+template<class Key, class Value>
+Node<Key, Value>* LazyAVLTree<Key, Value>::relocateNode(Node<Key, Value>* node, NodeArena& arena)
+{
+    return arena.copy(*static_cast<LazyNode*>(node));
+}
+
+template<class Key, class Value>
+Node<Key, Value>* LazyAVLTree<Key, Value>::nextNode(Node<Key, Value>* node) const
+{
+    Node<Key, Value>* next = AVLTree<Key, Value>::nextNode(node);
+    while(next != NULL && isDead(next)){
+        next = this->successor(next);
+    }
+    return next;
+}
+
+template<class Key, class Value>
+Node<Key, Value>* LazyAVLTree<Key, Value>::previousNode(Node<Key, Value>* node) const
+{
+    Node<Key, Value>* previous = AVLTree<Key, Value>::previousNode(node);
+    while(previous != NULL && isDead(previous)){
+        previous = this->predecessor(previous);
+    }
+    return previous;
+}
+
+template<class Key, class Value>
+bool LazyAVLTree<Key, Value>::hiddenNode(Node<Key, Value>* node) const
+{
+    return isDead(node);
+}
+
+/**
+* Bulk changes end here. One that emptied the tree (clear) took the
+* tombstones and any purgeStep position with it.
+*/
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::refreshEnds()
+{
+    AVLTree<Key, Value>::refreshEnds();
+    if(this->root_ == NULL){
+        tombstones_ = 0;
+        endPurgePass();
+    }
+}
+
+#endif
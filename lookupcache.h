@@ -0,0 +1,208 @@
+#ifndef LOOKUPCACHE_H
+#define LOOKUPCACHE_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <atomic>
+#include <functional>
+#include "bst.h"
+#include "avlbst.h"
+
+/**
+* A search tree with a small cache in front of find, for loops that look
+* up the same few thousand keys over and over. The cache is two-way set
+* associative with LRU replacement in each set (a direct-mapped cache
+* lost about half its hits to keys sharing a slot). Each slot remembers
+* one key and its node, or that the key is absent, so repeated hits and
+* repeated misses both skip the descent.
+*
+* Every insert and remove bumps a version counter, as does every bulk
+* change (clear, compact, the batches), which all end in refreshEnds. A
+* slot only counts if it was filled under the current version, so one
+* update drops the whole cache in O(1). That suits trees that change slowly; a tree
+* updated between most lookups gains nothing.
+*
+* Lookups may run on any number of threads at once; updates still need
+* the tree to themselves, as everywhere else. Each set has a one-byte
+* lock that readers only ever try: a reader that finds it taken just
+* descends the tree, so no lookup ever waits. Key must be default
+* constructible and hashable with Hash.
+*/
+template <class Key, class Value, class Tree = AVLTree<Key, Value>, class Hash = std::hash<Key> >
+class CachedLookupTree : public Tree
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    explicit CachedLookupTree(size_t slots = 16384);
+
+    virtual void remove(const Key& key);
+    using Tree::remove;
+
+    void invalidate();
+
+    virtual size_t memoryUsage() const;
+
+protected:
+    virtual Node<Key, Value>* insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item);
+
+    struct Way
+    {
+        Way() : version(0), key(), node(NULL) { }
+
+        unsigned long version;      // 0: never filled
+        Key key;
+        Node<Key, Value>* node;     // NULL: key is not in the tree
+    };
+
+    struct Set
+    {
+        Set() : busy(false), recent(0) { }
+
+        std::atomic<bool> busy;
+        unsigned char recent;       // the way hit or filled last
+        Way ways[2];
+    };
+
+    Node<Key, Value>* cachedFind(const Key& key) const;
+    virtual void nodeMoved(Node<Key, Value>* from, Node<Key, Value>* to);
+    virtual Node<Key, Value>* lookupNode(const Key& key) const;
+    virtual void refreshEnds();
+
+    mutable std::vector<Set> sets_;
+    size_t mask_;
+    Hash hash_;
+    std::atomic<unsigned long> version_;
+};
+
+/**
+* slots is rounded up to a power of two (at least 2). Hits fall off
+* sharply once the hot keys fill more than about a quarter of the slots.
+*/
+template<class Key, class Value, class Tree, class Hash>
+CachedLookupTree<Key, Value, Tree, Hash>::CachedLookupTree(size_t slots) : version_(1)
+{
+    size_t sets = 1;
+    while(sets * 2 < slots){
+        sets *= 2;
+    }
+    std::vector<Set> table(sets);
+    sets_.swap(table);
+    mask_ = sets - 1;
+}
+
+/**
+* Drops every cached entry. Updates call it themselves, whichever type
+* they are made through, so callers never need to; calling it anyway only
+* costs the next lookups a descent.
+*/
+template<class Key, class Value, class Tree, class Hash>
+void CachedLookupTree<Key, Value, Tree, Hash>::invalidate()
+{
+    version_.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+* The node for key, or NULL, from the cache when key's set holds it under
+* the current version. A miss descends the tree and refills the way of
+* the set that was used least recently.
+*/
+template<class Key, class Value, class Tree, class Hash>
+Node<Key, Value>* CachedLookupTree<Key, Value, Tree, Hash>::cachedFind(const Key& key) const
+{
+    // std::hash is the identity for integers; spread the bits the mask keeps
+    uint64_t h = hash_(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    Set& set = sets_[(size_t)h & mask_];
+    unsigned long version = version_.load(std::memory_order_relaxed);
+
+    if(!set.busy.exchange(true, std::memory_order_acquire)){
+        for(unsigned char i = 0; i < 2; i++){
+            Way& way = set.ways[i];
+            if(way.version == version && !(way.key < key) && !(key < way.key)){
+                Node<Key, Value>* node = way.node;
+                set.recent = i;
+                set.busy.store(false, std::memory_order_release);
+                return node;
+            }
+        }
+        set.busy.store(false, std::memory_order_release);
+    }
+
+    Node<Key, Value>* node = Tree::lookupNode(key);
+    if(!set.busy.exchange(true, std::memory_order_acquire)){
+        // a way left over from an older version is free; else evict the LRU one
+        unsigned char victim = (unsigned char)(1 - set.recent);
+        if(set.ways[0].version != version){
+            victim = 0;
+        }
+        else if(set.ways[1].version != version){
+            victim = 1;
+        }
+        Way& way = set.ways[victim];
+        way.version = version;
+        way.key = key;
+        way.node = node;
+        set.recent = victim;
+        set.busy.store(false, std::memory_order_release);
+    }
+    return node;
+}
+
+/**
+* relocateStep moved a node the cache may point at.
+*/
+template<class Key, class Value, class Tree, class Hash>
+void CachedLookupTree<Key, Value, Tree, Hash>::nodeMoved(Node<Key, Value>* from, Node<Key, Value>* to)
+{
+    Tree::nodeMoved(from, to);
+    invalidate();
+}
+
+/**
+* A bulk change freed or replaced nodes the cache may point at.
+*/
+template<class Key, class Value, class Tree, class Hash>
+void CachedLookupTree<Key, Value, Tree, Hash>::refreshEnds()
+{
+    Tree::refreshEnds();
+    invalidate();
+}
+
+template<class Key, class Value, class Tree, class Hash>
+Node<Key, Value>* CachedLookupTree<Key, Value, Tree, Hash>::insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item)
+{
+    invalidate();
+    return Tree::insertFrom(start, new_item);
+}
+
+template<class Key, class Value, class Tree, class Hash>
+void CachedLookupTree<Key, Value, Tree, Hash>::remove(const Key& key)
+{
+    invalidate();
+    Tree::remove(key);
+}
+
+/**
+* find and operator[] come here, through whichever type they are called.
+*/
+template<class Key, class Value, class Tree, class Hash>
+Node<Key, Value>* CachedLookupTree<Key, Value, Tree, Hash>::lookupNode(const Key& key) const
+{
+    return cachedFind(key);
+}
+
+template<class Key, class Value, class Tree, class Hash>
+size_t CachedLookupTree<Key, Value, Tree, Hash>::memoryUsage() const
+{
+    return Tree::memoryUsage() + sets_.size() * sizeof(Set);
+}
+
+#endif
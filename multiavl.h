@@ -0,0 +1,360 @@
+#ifndef MULTIAVL_H
+#define MULTIAVL_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <utility>
+#include "avlbst.h"
+
+/**
+* An AVL multimap: insert never overwrites, so a key can be stored any
+* number of times, and the copies of a key are visited in the order they
+* were inserted. A new copy descends to the right of every equal key, so
+* it lands after them in key order; rotations and the predecessor swap in
+* remove keep the in-order sequence, so the order survives rebalancing.
+*
+* find, operator[] and remove(key) act on the oldest copy. The batch
+* operations and the hinted find of AVLTree assume one node per key, so
+* they are hidden here.
+*/
+template <class Key, class Value>
+class AVLMultiTree : public AVLTree<Key, Value>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    virtual void remove(const Key& key);
+    using AVLTree<Key, Value>::remove;
+
+    iterator find(const Key& key) const;
+    template<typename K, typename = typename std::enable_if<IsTransparentKey<Key, K>::value>::type>
+    iterator find(const K& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+    size_t count(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key) const;
+    size_t erase(const Key& key);
+
+protected:
+    virtual Node<Key, Value>* insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item);
+    virtual Node<Key, Value>* lookupNode(const Key& key) const;
+    template<typename K>
+    Node<Key, Value>* lowerNode(const K& key) const;
+    Node<Key, Value>* upperNode(const Key& key) const;
+    AVLNode<Key, Value>* eraseEqual(AVLNode<Key, Value>* root, int height, const Key& key, size_t& removed, int& newHeight);
+    AVLNode<Key, Value>* eraseEqualSuffix(AVLNode<Key, Value>* root, int height, const Key& key, size_t& removed, int& newHeight);
+    AVLNode<Key, Value>* eraseEqualPrefix(AVLNode<Key, Value>* root, int height, const Key& key, size_t& removed, int& newHeight);
+    static void deleteSubtree(AVLNode<Key, Value>* root, size_t& removed);
+    // popMax has to take the newest copy, which remove(key) would not
+    virtual void eraseNode(Node<Key, Value>* node);
+
+private:
+    // one value per key: a batch would overwrite or remove a single copy
+    using AVLTree<Key, Value>::insertBatch;
+    using AVLTree<Key, Value>::removeBatch;
+    using AVLTree<Key, Value>::buildFromUnsorted;
+};
+
+/**
+* The first node whose key is not less than key, or NULL.
+*/
+template<class Key, class Value>
+template<typename K>
+Node<Key, Value>* AVLMultiTree<Key, Value>::lowerNode(const K& key) const
+{
+    Node<Key, Value>* current = this->root_;
+    Node<Key, Value>* result = NULL;
+    while(current != NULL){
+        if(current->getKey() < key){
+            current = current->getRight();
+        }
+        else{
+            result = current;
+            current = current->getLeft();
+        }
+    }
+    return result;
+}
+
+/**
+* The first node whose key is greater than key, or NULL.
+*/
+template<class Key, class Value>
+Node<Key, Value>* AVLMultiTree<Key, Value>::upperNode(const Key& key) const
+{
+    Node<Key, Value>* current = this->root_;
+    Node<Key, Value>* result = NULL;
+    while(current != NULL){
+        if(key < current->getKey()){
+            result = current;
+            current = current->getLeft();
+        }
+        else{
+            current = current->getRight();
+        }
+    }
+    return result;
+}
+
+/*
+ * Always adds a node, after any copies of the key already stored. Those
+ * need not all be below start, so the descent starts at the root.
+ */
+template<class Key, class Value>
+Node<Key, Value>* AVLMultiTree<Key, Value>::insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item)
+{
+    Node<Key, Value>* parent = NULL;
+    Node<Key, Value>* current = this->root_;
+    while(current != NULL){
+        parent = current;
+        current = (new_item.first < current->getKey()) ? current->getLeft() : current->getRight();
+    }
+
+    AVLNode<Key, Value>* addition = this->createNode(new_item.first, new_item.second);
+    this->attachLeaf(parent, addition);
+    this->retraceInsert(addition);
+    this->refreshPath(addition);
+    return addition;
+}
+
+/*
+ * Removes the oldest copy of key only; see erase for all of them.
+ */
+template<class Key, class Value>
+void AVLMultiTree<Key, Value>::remove(const Key& key)
+{
+    Node<Key, Value>* first = lowerNode(key);
+    if(first != NULL && !(key < first->getKey())){
+        this->removeNode(static_cast<AVLNode<Key, Value>*>(first));
+    }
+}
+
+template<class Key, class Value>
+void AVLMultiTree<Key, Value>::eraseNode(Node<Key, Value>* node)
+{
+    this->removeNode(static_cast<AVLNode<Key, Value>*>(node));
+}
+
+/**
+* Returns the oldest copy of key, or end().
+*/
+template<class Key, class Value>
+typename AVLMultiTree<Key, Value>::iterator AVLMultiTree<Key, Value>::find(const Key& key) const
+{
+    iterator it;
+    it.tree_ = this;
+    it.current_ = lookupNode(key);
+    return it;
+}
+
+/**
+* The oldest copy of key, or NULL; also what find and operator[] of the
+* base classes return.
+*/
+template<class Key, class Value>
+Node<Key, Value>* AVLMultiTree<Key, Value>::lookupNode(const Key& key) const
+{
+    Node<Key, Value>* first = lowerNode(key);
+    return (first != NULL && !(key < first->getKey())) ? first : NULL;
+}
+
+/**
+* Heterogeneous find, also returning the oldest copy.
+*/
+template<class Key, class Value>
+template<typename K, typename>
+typename AVLMultiTree<Key, Value>::iterator AVLMultiTree<Key, Value>::find(const K& key) const
+{
+    iterator it;
+    it.tree_ = this;
+    Node<Key, Value>* first = lowerNode(key);
+    if(first != NULL && !(key < first->getKey())){
+        it.current_ = first;
+    }
+    return it;
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value of the oldest copy of key
+*/
+template<class Key, class Value>
+Value& AVLMultiTree<Key, Value>::operator[](const Key& key)
+{
+    iterator it = find(key);
+    if(it == this->end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+template<class Key, class Value>
+Value const & AVLMultiTree<Key, Value>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if(it == this->end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+/**
+* Number of copies of key. O(log n + k) for k copies.
+*/
+template<class Key, class Value>
+size_t AVLMultiTree<Key, Value>::count(const Key& key) const
+{
+    std::pair<iterator, iterator> range = equal_range(key);
+    size_t result = 0;
+    for(iterator it = range.first; it != range.second; ++it){
+        result++;
+    }
+    return result;
+}
+
+/**
+* The copies of key, oldest first, as a half open range of iterators.
+* Both are end() if there are none past the last copy.
+*/
+template<class Key, class Value>
+std::pair<typename AVLMultiTree<Key, Value>::iterator, typename AVLMultiTree<Key, Value>::iterator>
+AVLMultiTree<Key, Value>::equal_range(const Key& key) const
+{
+    iterator first;
+    iterator last;
+    first.current_ = lowerNode(key);
+    first.tree_ = this;
+    last.current_ = upperNode(key);
+    last.tree_ = this;
+    return std::make_pair(first, last);
+}
+
+/**
+* Removes every copy of key and returns how many there were.
+*
+* The copies are one contiguous run in key order. The tree is split along
+* the search paths to either end of the run with AVL joins, the run's
+* nodes are freed without any per-node rebalancing, and the two sides are
+* joined back. Subtree heights are passed down from the root's and the
+* joins along a path telescope, so k copies cost O(log n + k) rather than
+* k separate removals.
+*/
+template<class Key, class Value>
+size_t AVLMultiTree<Key, Value>::erase(const Key& key)
+{
+    if(this->findNode(key) == NULL){
+        return 0;
+    }
+
+    size_t removed = 0;
+    int height;
+    AVLNode<Key, Value>* root = static_cast<AVLNode<Key, Value>*>(this->root_);
+    root = eraseEqual(root, this->subtreeHeight(root), key, removed, height);
+    if(root != NULL){
+        root->setParent(NULL);
+    }
+    this->root_ = root;
+    this->manyNodes -= removed;
+    this->refreshEnds();
+    return removed;
+}
+
+/**
+* Removes the copies of key from the detached subtree at root, of the
+* given height, and returns the rebalanced remainder and its height.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLMultiTree<Key, Value>::eraseEqual(AVLNode<Key, Value>* root, int height, const Key& key, size_t& removed, int& newHeight)
+{
+    if(root == NULL){
+        newHeight = 0;
+        return NULL;
+    }
+
+    int hl, hr, h;
+    this->childHeights(root, height, hl, hr);
+    AVLNode<Key, Value>* left = this->detachLeft(root);
+    AVLNode<Key, Value>* right = this->detachRight(root);
+    if(root->getKey() < key){
+        right = eraseEqual(right, hr, key, removed, h);
+        return this->joinTrees(left, hl, root, right, h, newHeight);
+    }
+    if(key < root->getKey()){
+        left = eraseEqual(left, hl, key, removed, h);
+        return this->joinTrees(left, h, root, right, hr, newHeight);
+    }
+
+    // the run of copies goes on into the end of left and the start of right
+    int hs;
+    left = eraseEqualSuffix(left, hl, key, removed, hs);
+    right = eraseEqualPrefix(right, hr, key, removed, h);
+    delete root;
+    removed++;
+    return this->joinTrees(left, hs, right, h, newHeight);
+}
+
+/**
+* For a detached subtree with no key above key: removes its copies of
+* key, which all sit at its right end.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLMultiTree<Key, Value>::eraseEqualSuffix(AVLNode<Key, Value>* root, int height, const Key& key, size_t& removed, int& newHeight)
+{
+    if(root == NULL){
+        newHeight = 0;
+        return NULL;
+    }
+
+    int hl, hr, h;
+    this->childHeights(root, height, hl, hr);
+    AVLNode<Key, Value>* left = this->detachLeft(root);
+    AVLNode<Key, Value>* right = this->detachRight(root);
+    if(root->getKey() < key){
+        right = eraseEqualSuffix(right, hr, key, removed, h);
+        return this->joinTrees(left, hl, root, right, h, newHeight);
+    }
+
+    // root is a copy, so everything to its right is one too
+    deleteSubtree(right, removed);
+    delete root;
+    removed++;
+    return eraseEqualSuffix(left, hl, key, removed, newHeight);
+}
+
+/**
+* Mirror image of eraseEqualSuffix, for a subtree with no key below key.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLMultiTree<Key, Value>::eraseEqualPrefix(AVLNode<Key, Value>* root, int height, const Key& key, size_t& removed, int& newHeight)
+{
+    if(root == NULL){
+        newHeight = 0;
+        return NULL;
+    }
+
+    int hl, hr, h;
+    this->childHeights(root, height, hl, hr);
+    AVLNode<Key, Value>* left = this->detachLeft(root);
+    AVLNode<Key, Value>* right = this->detachRight(root);
+    if(key < root->getKey()){
+        left = eraseEqualPrefix(left, hl, key, removed, h);
+        return this->joinTrees(left, h, root, right, hr, newHeight);
+    }
+
+    deleteSubtree(left, removed);
+    delete root;
+    removed++;
+    return eraseEqualPrefix(right, hr, key, removed, newHeight);
+}
+
+template<class Key, class Value>
+void AVLMultiTree<Key, Value>::deleteSubtree(AVLNode<Key, Value>* root, size_t& removed)
+{
+    if(root == NULL){
+        return;
+    }
+    deleteSubtree(root->getLeft(), removed);
+    deleteSubtree(root->getRight(), removed);
+    delete root;
+    removed++;
+}
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef NODEARENA_H
+#define NODEARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <atomic>
+
+/**
+* Contiguous storage for the nodes of a compacted tree.
+*
+* A slab is one allocation cut into chunks of a power-of-two size,
+* aligned to that size, and nodes are placed in it one after another.
+* The first bytes of every chunk point back to the slab, so a node can
+* find its slab from its own address and be freed with a plain delete
+* like any other node (see ArenaNode). The memory goes back to the heap
+* once the last node in the slab is deleted and the arena filling it has
+* been closed.
+*/
+class NodeArena
+{
+public:
+    struct Slab
+    {
+        char* raw;
+        size_t bytes;
+        std::atomic<size_t> nodes;  // live nodes, plus one while the arena is open; the memory goes with the last
+        std::atomic<size_t> refs;   // nodes + handles; the Slab goes with the last one
+    };
+
+    explicit NodeArena(size_t count);
+
+    template<class NodeT>
+    NodeT* copy(const NodeT& node);
+
+    Slab* handle() const;
+    Slab* close();
+    bool full() const;
+    bool holds(const void* node) const;
+
+    static constexpr size_t chunkBytes(size_t nodeBytes, size_t chunk = 4096)
+    {
+        return (chunk >= 16 * nodeBytes) ? chunk : chunkBytes(nodeBytes, chunk * 2);
+    }
+    static size_t heapFootprint(size_t bytes);
+    static void releaseNode(void* node, size_t chunk);
+    static void releaseHandle(Slab* slab);
+
+private:
+    static const size_t HEADER = alignof(std::max_align_t);
+
+    void allocate(size_t nodeBytes, size_t chunk);
+
+    size_t count_;
+    size_t placed_;
+    Slab* slab_;
+    size_t chunk_;
+    char* cursor_;
+    char* chunkEnd_;
+};
+
+/**
+* A node of type NodeT that lives in a NodeArena. It adds no data, only
+* the operator delete that hands the memory back to the slab, which the
+* virtual destructor of Node picks for any delete of the node.
+*/
+template <class NodeT>
+class ArenaNode : public NodeT
+{
+public:
+    static const size_t CHUNK = NodeArena::chunkBytes(sizeof(NodeT));
+
+    explicit ArenaNode(const NodeT& other) : NodeT(other) { }
+
+    static void* operator new(size_t, void* place) { return place; }
+    static void operator delete(void*, void*) { }
+    static void operator delete(void* node) { NodeArena::releaseNode(node, CHUNK); }
+};
+
+template <class NodeT>
+const size_t ArenaNode<NodeT>::CHUNK;
+
+/**
+* An arena for count nodes. The slab is allocated on the first copy, once
+* the node type, and so the chunk size, is known. The arena holds a handle
+* on the slab, and keeps its memory alive, until it is closed.
+*/
+inline NodeArena::NodeArena(size_t count) : count_(count), placed_(0), slab_(NULL), chunk_(0), cursor_(NULL), chunkEnd_(NULL)
+{
+
+}
+
+inline void NodeArena::allocate(size_t nodeBytes, size_t chunk)
+{
+    size_t perChunk = (chunk - HEADER) / nodeBytes;
+    size_t chunks = (count_ + perChunk - 1) / perChunk;
+
+    // one chunk extra, to align the first one
+    slab_ = new Slab;
+    slab_->bytes = (chunks + 1) * chunk;
+    slab_->raw = static_cast<char*>(::operator new(slab_->bytes));
+    slab_->nodes = 1;
+    slab_->refs = 1;
+
+    chunk_ = chunk;
+    cursor_ = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(slab_->raw) + chunk - 1) & ~(uintptr_t)(chunk - 1));
+    chunkEnd_ = cursor_;
+}
+
+/**
+* Places a copy of node in the arena and returns it. Links are copied as
+* they are; the caller relinks the copies. Every node in one arena must
+* have the same type.
+*/
+template<class NodeT>
+NodeT* NodeArena::copy(const NodeT& node)
+{
+    size_t size = (sizeof(ArenaNode<NodeT>) + HEADER - 1) / HEADER * HEADER;
+    if(slab_ == NULL){
+        allocate(size, ArenaNode<NodeT>::CHUNK);
+    }
+    if(cursor_ + size > chunkEnd_){
+        cursor_ = chunkEnd_;
+        *reinterpret_cast<Slab**>(cursor_) = slab_;
+        chunkEnd_ = cursor_ + chunk_;
+        cursor_ += HEADER;
+    }
+    NodeT* result = new (cursor_) ArenaNode<NodeT>(node);
+    cursor_ += size;
+    placed_++;
+    slab_->nodes++;
+    slab_->refs++;
+    return result;
+}
+
+inline NodeArena::Slab* NodeArena::handle() const
+{
+    return slab_;
+}
+
+/**
+* Ends placing, once: the slab's memory may now go with its last node.
+* Returns the arena's handle, which the caller takes over and drops with
+* releaseHandle().
+*/
+inline NodeArena::Slab* NodeArena::close()
+{
+    if(slab_ != NULL && slab_->nodes.fetch_sub(1) == 1){
+        ::operator delete(slab_->raw);
+        slab_->raw = NULL;
+    }
+    return slab_;
+}
+
+/**
+* True once count nodes have been placed.
+*/
+inline bool NodeArena::full() const
+{
+    return placed_ >= count_;
+}
+
+/**
+* True if node lives in this arena's slab.
+*/
+inline bool NodeArena::holds(const void* node) const
+{
+    if(slab_ == NULL || slab_->raw == NULL){
+        return false;
+    }
+    const char* address = static_cast<const char*>(node);
+    return address >= slab_->raw && address < slab_->raw + slab_->bytes;
+}
+
+/**
+* Bytes a heap allocation of the given size takes, as glibc malloc lays
+* it out: an 8-byte header, rounded up to 16 bytes, at least 32.
+*/
+inline size_t NodeArena::heapFootprint(size_t bytes)
+{
+    size_t footprint = (bytes + 8 + 15) & ~(size_t)15;
+    return (footprint < 32) ? 32 : footprint;
+}
+
+inline void NodeArena::releaseNode(void* node, size_t chunk)
+{
+    char* start = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(node) & ~(uintptr_t)(chunk - 1));
+    Slab* slab = *reinterpret_cast<Slab**>(start);
+    if(slab->nodes.fetch_sub(1) == 1){
+        ::operator delete(slab->raw);
+        slab->raw = NULL;
+    }
+    if(slab->refs.fetch_sub(1) == 1){
+        delete slab;
+    }
+}
+
+/**
+* Drops a handle taken from close(). The last one frees the Slab, and the
+* memory if nothing else has.
+*/
+inline void NodeArena::releaseHandle(Slab* slab)
+{
+    if(slab != NULL && slab->refs.fetch_sub(1) == 1){
+        ::operator delete(slab->raw);
+        delete slab;
+    }
+}
+
+#endif
@@ -0,0 +1,337 @@
+#ifndef RBBST_H
+#define RBBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <algorithm>
+#include "bst.h"
+
+/**
+* A node for a red-black tree, which adds the color as a data member.
+*/
+template <typename Key, typename Value>
+class RBNode : public Node<Key, Value>
+{
+public:
+    RBNode(const Key& key, const Value& value, RBNode<Key, Value>* parent);
+    virtual ~RBNode();
+
+    bool isRed() const;
+    void setRed(bool red);
+
+    virtual RBNode<Key, Value>* getParent() const override;
+    virtual RBNode<Key, Value>* getLeft() const override;
+    virtual RBNode<Key, Value>* getRight() const override;
+
+protected:
+    bool red_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the RBNode class.
+  -------------------------------------------------
+*/
+
+/**
+* New nodes start out red.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::RBNode(const Key& key, const Value& value, RBNode<Key, Value> *parent) :
+        Node<Key, Value>(key, value, parent), red_(true)
+{
+
+}
+
+template<class Key, class Value>
+RBNode<Key, Value>::~RBNode()
+{
+
+}
+
+template<class Key, class Value>
+bool RBNode<Key, Value>::isRed() const
+{
+    return red_;
+}
+
+template<class Key, class Value>
+void RBNode<Key, Value>::setRed(bool red)
+{
+    red_ = red;
+}
+
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getParent() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->parent_);
+}
+
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getLeft() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->left_);
+}
+
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getRight() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the RBNode class.
+  -----------------------------------------------
+*/
+
+/**
+* A red-black tree. Looser balance than AVL (height up to 2 log n), but
+* an insert does at most two rotations and a remove at most three, and
+* recoloring is amortized O(1) per update.
+*/
+template <class Key, class Value>
+class RBTree : public BinarySearchTree<Key, Value>
+{
+public:
+    virtual void remove(const Key& key);
+    using BinarySearchTree<Key, Value>::remove;
+    using BinarySearchTree<Key, Value>::insert;
+
+    virtual void rebalance();
+
+protected:
+    virtual Node<Key, Value>* insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item);
+    virtual void nodeSwap(Node<Key, Value>* n1, Node<Key, Value>* n2);
+    virtual size_t nodeSize() const;
+    virtual Node<Key, Value>* relocateNode(Node<Key, Value>* node, NodeArena& arena);
+
+    static bool isRed(RBNode<Key, Value>* node);
+    void fixInsert(RBNode<Key, Value>* node);
+    void fixRemove(RBNode<Key, Value>* node, RBNode<Key, Value>* parent);
+    static void paintLevels(RBNode<Key, Value>* root, int depth, int bottom);
+};
+
+/**
+* NULL children count as black.
+*/
+template<class Key, class Value>
+bool RBTree<Key, Value>::isRed(RBNode<Key, Value>* node)
+{
+    return node != NULL && node->isRed();
+}
+
+template<class Key, class Value>
+size_t RBTree<Key, Value>::nodeSize() const
+{
+    return sizeof(RBNode<Key, Value>);
+}
+
+template<class Key, class Value>
+Node<Key, Value>* RBTree<Key, Value>::relocateNode(Node<Key, Value>* node, NodeArena& arena)
+{
+    return arena.copy(*static_cast<RBNode<Key, Value>*>(node));
+}
+
+/**
+* Swaps two nodes' places like the base version; the colors stay with the
+* places, so they are swapped too.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::nodeSwap(Node<Key, Value>* n1, Node<Key, Value>* n2)
+{
+    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    RBNode<Key, Value>* r1 = static_cast<RBNode<Key, Value>*>(n1);
+    RBNode<Key, Value>* r2 = static_cast<RBNode<Key, Value>*>(n2);
+    bool tempRed = r1->isRed();
+    r1->setRed(r2->isRed());
+    r2->setRed(tempRed);
+}
+
+/**
+* DSW leaves every level full but the bottom one, so coloring the bottom
+* level red and the rest black gives each path the same black height.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::rebalance()
+{
+    BinarySearchTree<Key, Value>::rebalance();
+    paintLevels(static_cast<RBNode<Key, Value>*>(this->root_), 0, this->getHeight(this->root_));
+}
+
+/**
+* Colors the nodes at depth bottom red (but never the root) and the ones
+* above black.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::paintLevels(RBNode<Key, Value>* root, int depth, int bottom)
+{
+    if(root == NULL){
+        return;
+    }
+    root->setRed(depth == bottom && depth > 0);
+    paintLevels(root->getLeft(), depth + 1, bottom);
+    paintLevels(root->getRight(), depth + 1, bottom);
+}
+
+/*
+ * If key is already in the tree, the value is overwritten.
+ */
+template<class Key, class Value>
+Node<Key, Value>* RBTree<Key, Value>::insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item)
+{
+    Node<Key, Value>* parent;
+    Node<Key, Value>* existing = this->findInsertPoint(start, new_item.first, parent);
+    if(existing != NULL){
+        existing->setValue(new_item.second);
+        return existing;
+    }
+
+    RBNode<Key, Value>* addition = new RBNode<Key, Value>(new_item.first, new_item.second, NULL);
+    this->attachLeaf(parent, addition);
+    fixInsert(addition);
+    return addition;
+}
+
+/**
+* Removes a red-red violation at node by recoloring up the tree, ending
+* with at most two rotations.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::fixInsert(RBNode<Key, Value>* node)
+{
+    while(isRed(node->getParent())){
+        RBNode<Key, Value>* parent = node->getParent();
+        RBNode<Key, Value>* grand = parent->getParent();
+        bool parentIsLeft = (grand->getLeft() == parent);
+        RBNode<Key, Value>* uncle = parentIsLeft ? grand->getRight() : grand->getLeft();
+
+        if(isRed(uncle)){
+            parent->setRed(false);
+            uncle->setRed(false);
+            grand->setRed(true);
+            node = grand;
+            continue;
+        }
+
+        if(parentIsLeft){
+            if(node == parent->getRight()){
+                this->rotateLeftNode(parent);
+                parent = node;
+            }
+            this->rotateRightNode(grand);
+        }
+        else{
+            if(node == parent->getLeft()){
+                this->rotateRightNode(parent);
+                parent = node;
+            }
+            this->rotateLeftNode(grand);
+        }
+        parent->setRed(false);
+        grand->setRed(true);
+        break;
+    }
+    static_cast<RBNode<Key, Value>*>(this->root_)->setRed(false);
+}
+
+/*
+ * A node with two children is swapped with its predecessor first, like
+ * the other trees, so it has at most one child when it is unlinked.
+ */
+template<class Key, class Value>
+void RBTree<Key, Value>::remove(const Key& key)
+{
+    RBNode<Key, Value>* current = static_cast<RBNode<Key, Value>*>(this->internalFind(key));
+    if(current == NULL){
+        return;
+    }
+
+    if(this->twoChild(current)){
+        nodeSwap(current, this->predecessor(current));
+    }
+    this->trackRemoval(current);
+
+    RBNode<Key, Value>* parent = current->getParent();
+    RBNode<Key, Value>* child = (current->getLeft() != NULL) ? current->getLeft() : current->getRight();
+    bool removedBlack = !current->isRed();
+    this->replaceChild(parent, current, child);
+    delete current;
+    this->manyNodes--;
+
+    if(removedBlack){
+        fixRemove(child, parent);
+    }
+}
+
+/**
+* Restores equal black heights after a black node was unlinked. node is
+* the child that took its place (possibly NULL) and carries an extra black.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::fixRemove(RBNode<Key, Value>* node, RBNode<Key, Value>* parent)
+{
+    while(node != this->root_ && !isRed(node)){
+        // a NULL node with a NULL left sibling slot must be the left child,
+        // since the other side is at least one black node high
+        bool isLeft = (node != NULL) ? (node == parent->getLeft()) : (parent->getLeft() == NULL);
+
+        if(isLeft){
+            RBNode<Key, Value>* sibling = parent->getRight();
+            if(isRed(sibling)){
+                sibling->setRed(false);
+                parent->setRed(true);
+                this->rotateLeftNode(parent);
+                sibling = parent->getRight();
+            }
+            if(!isRed(sibling->getLeft()) && !isRed(sibling->getRight())){
+                sibling->setRed(true);
+                node = parent;
+                parent = node->getParent();
+                continue;
+            }
+            if(!isRed(sibling->getRight())){
+                sibling->getLeft()->setRed(false);
+                sibling->setRed(true);
+                this->rotateRightNode(sibling);
+                sibling = parent->getRight();
+            }
+            sibling->setRed(parent->isRed());
+            parent->setRed(false);
+            sibling->getRight()->setRed(false);
+            this->rotateLeftNode(parent);
+        }
+        else{
+            RBNode<Key, Value>* sibling = parent->getLeft();
+            if(isRed(sibling)){
+                sibling->setRed(false);
+                parent->setRed(true);
+                this->rotateRightNode(parent);
+                sibling = parent->getLeft();
+            }
+            if(!isRed(sibling->getLeft()) && !isRed(sibling->getRight())){
+                sibling->setRed(true);
+                node = parent;
+                parent = node->getParent();
+                continue;
+            }
+            if(!isRed(sibling->getLeft())){
+                sibling->getRight()->setRed(false);
+                sibling->setRed(true);
+                this->rotateLeftNode(sibling);
+                sibling = parent->getLeft();
+            }
+            sibling->setRed(parent->isRed());
+            parent->setRed(false);
+            sibling->getLeft()->setRed(false);
+            this->rotateRightNode(parent);
+        }
+        node = static_cast<RBNode<Key, Value>*>(this->root_);
+    }
+    if(node != NULL){
+        node->setRed(false);
+    }
+}
+
+#endif
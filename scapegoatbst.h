@@ -0,0 +1,231 @@
+#ifndef SCAPEGOATBST_H
+#define SCAPEGOATBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "bst.h"
+
+/**
+* A scapegoat tree: a plain BST that keeps no balance data in its nodes,
+* only a second size counter next to manyNodes. When an insert lands
+* deeper than log_{1/alpha}(n), the lowest ancestor whose subtree is more
+* than alpha out of weight balance (the scapegoat) is rebuilt into a
+* perfectly balanced subtree. When removes have shrunk the tree below
+* alpha times its largest size since the last full rebuild, the whole
+* tree is rebuilt. Updates are amortized O(log n) and lookups are
+* worst-case O(log n); alpha (kept within 0.5 to 0.95) trades lookup
+* depth against rebuilding work.
+*/
+template <class Key, class Value>
+class ScapegoatTree : public BinarySearchTree<Key, Value>
+{
+public:
+    explicit ScapegoatTree(double alpha = 0.7);
+
+    virtual void remove(const Key& key);
+    using BinarySearchTree<Key, Value>::remove;
+
+    double getAlpha() const;
+    unsigned long rebuiltNodes() const;
+
+protected:
+    virtual Node<Key, Value>* insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item);
+    virtual void refreshEnds();
+    int depthLimit() const;
+    static int subtreeSize(Node<Key, Value>* root);
+    void rebuild(Node<Key, Value>* root);
+    static Node<Key, Value>* linkBalanced(std::vector<Node<Key, Value>*>& nodes, int low, int high, Node<Key, Value>* parent);
+
+    double alpha_;
+    double logInverseAlpha_;
+    int maxNodes_;              // largest manyNodes since the last full rebuild
+    unsigned long rebuilt_;     // nodes relinked by rebuilds, for benchmarking
+};
+
+template<class Key, class Value>
+ScapegoatTree<Key, Value>::ScapegoatTree(double alpha) :
+        alpha_(std::min(std::max(alpha, 0.5), 0.95)),
+        logInverseAlpha_(std::log(1.0 / alpha_)),
+        maxNodes_(0),
+        rebuilt_(0)
+{
+
+}
+
+template<class Key, class Value>
+double ScapegoatTree<Key, Value>::getAlpha() const
+{
+    return alpha_;
+}
+
+template<class Key, class Value>
+unsigned long ScapegoatTree<Key, Value>::rebuiltNodes() const
+{
+    return rebuilt_;
+}
+
+/**
+* Bulk changes end here; clear leaves the tree empty, which starts the
+* largest-size count over. compact keeps the shape, so it changes nothing.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::refreshEnds()
+{
+    BinarySearchTree<Key, Value>::refreshEnds();
+    if(this->root_ == NULL){
+        maxNodes_ = 0;
+    }
+}
+
+/**
+* Deepest a node may sit (root = 0) before an insert looks for a scapegoat.
+*/
+template<class Key, class Value>
+int ScapegoatTree<Key, Value>::depthLimit() const
+{
+    return (int)(std::log((double)this->manyNodes) / logInverseAlpha_);
+}
+
+/*
+ * If key is already in the tree, the value is overwritten. Otherwise the
+ * new leaf's depth is counted on the way back up, and if it is too deep
+ * the climb goes on, counting subtree sizes, until the first ancestor
+ * whose child on the path holds more than alpha of its nodes.
+ */
+template<class Key, class Value>
+Node<Key, Value>* ScapegoatTree<Key, Value>::insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item)
+{
+    Node<Key, Value>* parent;
+    Node<Key, Value>* existing = this->findInsertPoint(start, new_item.first, parent);
+    if(existing != NULL){
+        existing->setValue(new_item.second);
+        return existing;
+    }
+
+    Node<Key, Value>* addition = new Node<Key, Value>(new_item.first, new_item.second, NULL);
+    this->attachLeaf(parent, addition);
+    maxNodes_ = std::max(maxNodes_, this->manyNodes);
+
+    int depth = 0;
+    for(Node<Key, Value>* up = parent; up != NULL; up = up->getParent()){
+        depth++;
+    }
+    if(depth <= depthLimit()){
+        return addition;
+    }
+
+    Node<Key, Value>* child = addition;
+    int childSize = 1;
+    for(Node<Key, Value>* up = parent; up != NULL; up = up->getParent()){
+        Node<Key, Value>* sibling = (up->getLeft() == child) ? up->getRight() : up->getLeft();
+        int size = childSize + 1 + subtreeSize(sibling);
+        if(childSize > alpha_ * size){
+            rebuild(up);
+            return addition;
+        }
+        child = up;
+        childSize = size;
+    }
+    return addition;
+}
+
+/*
+ * A node with two children trades places with its predecessor first, so
+ * the one unlinked has at most one child.
+ */
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::remove(const Key& key)
+{
+    Node<Key, Value>* current = this->internalFind(key);
+    if(current == NULL){
+        return;
+    }
+
+    if(this->twoChild(current)){
+        this->nodeSwap(current, this->predecessor(current));
+    }
+    this->trackRemoval(current);
+    Node<Key, Value>* child = (current->getLeft() != NULL) ? current->getLeft() : current->getRight();
+    this->replaceChild(current->getParent(), current, child);
+    delete current;
+    this->manyNodes--;
+
+    if(this->manyNodes < alpha_ * maxNodes_){
+        rebuild(this->root_);
+        maxNodes_ = this->manyNodes;
+    }
+}
+
+template<class Key, class Value>
+int ScapegoatTree<Key, Value>::subtreeSize(Node<Key, Value>* root)
+{
+    int size = 0;
+    std::vector<Node<Key, Value>*> pending;
+    if(root != NULL){
+        pending.push_back(root);
+    }
+    while(!pending.empty()){
+        Node<Key, Value>* current = pending.back();
+        pending.pop_back();
+        size++;
+        if(current->getLeft() != NULL){
+            pending.push_back(current->getLeft());
+        }
+        if(current->getRight() != NULL){
+            pending.push_back(current->getRight());
+        }
+    }
+    return size;
+}
+
+/**
+* Relinks the subtree at root into perfect balance, in place: the nodes are
+* gathered in key order and the middle one of each range becomes the
+* parent of the two halves.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::rebuild(Node<Key, Value>* root)
+{
+    if(root == NULL){
+        return;
+    }
+
+    Node<Key, Value>* above = root->getParent();
+    std::vector<Node<Key, Value>*> nodes;
+    std::vector<Node<Key, Value>*> pending;
+    Node<Key, Value>* current = root;
+    while(current != NULL || !pending.empty()){
+        while(current != NULL){
+            pending.push_back(current);
+            current = current->getLeft();
+        }
+        current = pending.back();
+        pending.pop_back();
+        nodes.push_back(current);
+        current = current->getRight();
+    }
+
+    Node<Key, Value>* top = linkBalanced(nodes, 0, (int)nodes.size() - 1, above);
+    this->replaceChild(above, root, top);
+    rebuilt_ += nodes.size();
+}
+
+template<class Key, class Value>
+Node<Key, Value>* ScapegoatTree<Key, Value>::linkBalanced(std::vector<Node<Key, Value>*>& nodes, int low, int high, Node<Key, Value>* parent)
+{
+    if(low > high){
+        return NULL;
+    }
+    int middle = low + (high - low) / 2;
+    Node<Key, Value>* node = nodes[middle];
+    node->setParent(parent);
+    node->setLeft(linkBalanced(nodes, low, middle - 1, node));
+    node->setRight(linkBalanced(nodes, middle + 1, high, node));
+    return node;
+}
+
+#endif
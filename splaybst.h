@@ -0,0 +1,343 @@
+#ifndef SPLAYBST_H
+#define SPLAYBST_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <algorithm>
+#include "bst.h"
+
+/**
+* How far an accessed node is moved up.
+*
+* SPLAY_FULL moves it all the way to the root (classic splaying).
+* SPLAY_SEMI only rotates the parent over the grandparent in the zig-zig
+* case and carries on from there, so roughly half the path is rewritten
+* and the node ends up about half way up.
+* SPLAY_DEPTH_THRESHOLD leaves nodes found within the threshold depth
+* alone, so hot keys near the root are read without writing to the tree,
+* and fully splays anything deeper.
+*/
+enum SplayMode
+{
+    SPLAY_FULL,
+    SPLAY_SEMI,
+    SPLAY_DEPTH_THRESHOLD
+};
+
+/**
+* A splay tree: every access moves the accessed node towards the root, so
+* a small working set of hot keys sits in the top few levels. Operations
+* are amortized O(log n) and no per-node metadata is stored; the nodes are
+* plain Nodes.
+*
+* Lookups through a non-const SplayTree restructure the tree. Lookups
+* through a const reference use the base versions and do not.
+*/
+template <class Key, class Value>
+class SplayTree : public BinarySearchTree<Key, Value>
+{
+public:
+    explicit SplayTree(SplayMode mode = SPLAY_FULL, int depthThreshold = 8);
+
+    virtual void remove(const Key& key);
+    using BinarySearchTree<Key, Value>::remove;
+
+    typename BinarySearchTree<Key, Value>::iterator find(const Key& key);
+    template<typename K, typename = typename std::enable_if<IsTransparentKey<Key, K>::value>::type>
+    typename BinarySearchTree<Key, Value>::iterator find(const K& key);
+    using BinarySearchTree<Key, Value>::find;
+    Value& operator[](const Key& key);
+    template<typename K, typename = typename std::enable_if<IsTransparentKey<Key, K>::value>::type>
+    Value& operator[](const K& key);
+    using BinarySearchTree<Key, Value>::operator[];
+
+    void setMode(SplayMode mode, int depthThreshold = 8);
+    SplayMode getMode() const;
+
+protected:
+    virtual Node<Key, Value>* insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item);
+    template<typename K>
+    Node<Key, Value>* access(const K& key);
+    void splay(Node<Key, Value>* node, int depth);
+    void splayFull(Node<Key, Value>* node);
+    void splaySemi(Node<Key, Value>* node);
+
+    SplayMode mode_;
+    int depthThreshold_;
+};
+
+template<class Key, class Value>
+SplayTree<Key, Value>::SplayTree(SplayMode mode, int depthThreshold) :
+        mode_(mode),
+        depthThreshold_(depthThreshold)
+{
+
+}
+
+template<class Key, class Value>
+void SplayTree<Key, Value>::setMode(SplayMode mode, int depthThreshold)
+{
+    mode_ = mode;
+    depthThreshold_ = depthThreshold;
+}
+
+template<class Key, class Value>
+SplayMode SplayTree<Key, Value>::getMode() const
+{
+    return mode_;
+}
+
+/**
+* Moves node up according to the mode. depth is its depth (root = 0),
+* which the caller already knows from its descent.
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::splay(Node<Key, Value>* node, int depth)
+{
+    if(node == NULL){
+        return;
+    }
+    switch(mode_){
+    case SPLAY_SEMI:
+        splaySemi(node);
+        break;
+    case SPLAY_DEPTH_THRESHOLD:
+        if(depth > depthThreshold_){
+            splayFull(node);
+        }
+        break;
+    default:
+        splayFull(node);
+        break;
+    }
+}
+
+/**
+* Classic bottom-up splay with zig, zig-zig and zig-zag steps.
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::splayFull(Node<Key, Value>* node)
+{
+    while(node->getParent() != NULL){
+        Node<Key, Value>* parent = node->getParent();
+        Node<Key, Value>* grand = parent->getParent();
+        bool nodeIsLeft = (parent->getLeft() == node);
+
+        if(grand == NULL){
+            if(nodeIsLeft){
+                this->rotateRightNode(parent);
+            }
+            else{
+                this->rotateLeftNode(parent);
+            }
+        }
+        else if(nodeIsLeft == (grand->getLeft() == parent)){
+            if(nodeIsLeft){
+                this->rotateRightNode(grand);
+                this->rotateRightNode(parent);
+            }
+            else{
+                this->rotateLeftNode(grand);
+                this->rotateLeftNode(parent);
+            }
+        }
+        else{
+            if(nodeIsLeft){
+                this->rotateRightNode(parent);
+                this->rotateLeftNode(grand);
+            }
+            else{
+                this->rotateLeftNode(parent);
+                this->rotateRightNode(grand);
+            }
+        }
+    }
+}
+
+/**
+* Semi-splay: a zig-zig step rotates only the parent over the grandparent
+* and continues from the parent, which leaves the accessed node about half
+* way up and halves the rotations.
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::splaySemi(Node<Key, Value>* node)
+{
+    while(node->getParent() != NULL){
+        Node<Key, Value>* parent = node->getParent();
+        Node<Key, Value>* grand = parent->getParent();
+        bool nodeIsLeft = (parent->getLeft() == node);
+
+        if(grand == NULL){
+            if(nodeIsLeft){
+                this->rotateRightNode(parent);
+            }
+            else{
+                this->rotateLeftNode(parent);
+            }
+        }
+        else if(nodeIsLeft == (grand->getLeft() == parent)){
+            if(nodeIsLeft){
+                this->rotateRightNode(grand);
+            }
+            else{
+                this->rotateLeftNode(grand);
+            }
+            node = parent;
+        }
+        else{
+            if(nodeIsLeft){
+                this->rotateRightNode(parent);
+                this->rotateLeftNode(grand);
+            }
+            else{
+                this->rotateLeftNode(parent);
+                this->rotateRightNode(grand);
+            }
+        }
+    }
+}
+
+/**
+* Looks key up and splays the node found, or the last node visited on a
+* miss, so repeated misses near the same spot get cheap too. On a miss
+* the descent has gone one level past last, so last sits at depth - 1.
+*/
+template<class Key, class Value>
+template<typename K>
+Node<Key, Value>* SplayTree<Key, Value>::access(const K& key)
+{
+    Node<Key, Value>* current = this->root_;
+    Node<Key, Value>* last = NULL;
+    int depth = 0;
+
+    while(current != NULL){
+        last = current;
+        if(key < current->getKey()){
+            current = current->getLeft();
+        }
+        else if(current->getKey() < key){
+            current = current->getRight();
+        }
+        else{
+            break;
+        }
+        depth++;
+    }
+
+    if(current != NULL){
+        splay(current, depth);
+    }
+    else{
+        splay(last, depth - 1);
+    }
+    return current;
+}
+
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator SplayTree<Key, Value>::find(const Key& key)
+{
+    typename BinarySearchTree<Key, Value>::iterator it;
+    it.current_ = access(key);
+    it.tree_ = this;
+    return it;
+}
+
+template<class Key, class Value>
+template<typename K, typename>
+typename BinarySearchTree<Key, Value>::iterator SplayTree<Key, Value>::find(const K& key)
+{
+    typename BinarySearchTree<Key, Value>::iterator it;
+    it.current_ = access(key);
+    it.tree_ = this;
+    return it;
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value associated with the key
+*/
+template<class Key, class Value>
+Value& SplayTree<Key, Value>::operator[](const Key& key)
+{
+    Node<Key, Value>* found = access(key);
+    if(found == NULL) throw std::out_of_range("Invalid key");
+    return found->getValue();
+}
+
+/**
+* Heterogeneous operator[], splaying like the one taking a Key.
+*/
+template<class Key, class Value>
+template<typename K, typename>
+Value& SplayTree<Key, Value>::operator[](const K& key)
+{
+    Node<Key, Value>* found = access(key);
+    if(found == NULL) throw std::out_of_range("Invalid key");
+    return found->getValue();
+}
+
+/*
+ * If key is already in the tree, the value is overwritten. Either way the
+ * node is splayed.
+ */
+template<class Key, class Value>
+Node<Key, Value>* SplayTree<Key, Value>::insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item)
+{
+    Node<Key, Value>* parent;
+    Node<Key, Value>* existing = this->findInsertPoint(start, new_item.first, parent);
+    if(existing != NULL){
+        existing->setValue(new_item.second);
+        splay(existing, this->depthThreshold_ + 1);
+        return existing;
+    }
+
+    Node<Key, Value>* addition = new Node<Key, Value>(new_item.first, new_item.second, NULL);
+    this->attachLeaf(parent, addition);
+    splay(addition, this->depthThreshold_ + 1);
+    return addition;
+}
+
+/*
+ * The node is splayed to the root and unlinked. The largest node of its
+ * left subtree is then splayed to the top of that subtree, where it has
+ * no right child, and the right subtree is hung there.
+ */
+template<class Key, class Value>
+void SplayTree<Key, Value>::remove(const Key& key)
+{
+    Node<Key, Value>* current = this->internalFind(key);
+    if(current == NULL){
+        return;
+    }
+    splayFull(current);
+    this->trackRemoval(current);
+
+    Node<Key, Value>* left = current->getLeft();
+    Node<Key, Value>* right = current->getRight();
+    delete current;
+    this->manyNodes--;
+
+    if(left == NULL){
+        this->root_ = right;
+        if(right != NULL){
+            right->setParent(NULL);
+        }
+        return;
+    }
+
+    left->setParent(NULL);
+    this->root_ = left;
+    Node<Key, Value>* largest = left;
+    while(largest->getRight() != NULL){
+        largest = largest->getRight();
+    }
+    splayFull(largest);
+    largest->setRight(right);
+    if(right != NULL){
+        right->setParent(largest);
+    }
+}
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <exception>
+
+/**
+* A fixed-size work-stealing thread pool.
+*
+* run() hands a list of tasks to the pool and blocks until all of them
+* have finished. Tasks are dealt round-robin onto one deque per worker;
+* a worker pops from the back of its own deque and, once that is empty,
+* steals from the front of the others, so a few slow tasks do not leave
+* the remaining threads idle. The calling thread works as worker 0.
+*
+* Callers on several threads may share a pool: their run() calls take
+* turns. A task that calls run() on the pool it is running on gets its
+* tasks done inline, one after another, since every worker may already
+* be waiting on it.
+*/
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(unsigned int threads = 0);
+    ~WorkStealingPool();
+
+    unsigned int size() const;
+    void run(const std::vector<std::function<void()> >& tasks);
+
+    static WorkStealingPool& shared();
+
+private:
+    WorkStealingPool(const WorkStealingPool&);
+    WorkStealingPool& operator=(const WorkStealingPool&);
+
+    struct TaskQueue
+    {
+        std::mutex lock;
+        std::deque<size_t> tasks;
+    };
+
+    static WorkStealingPool*& active();
+    static void runInline(const std::vector<std::function<void()> >& tasks);
+    bool take(unsigned int self, size_t& task);
+    void work(unsigned int self);
+    void workerLoop(unsigned int self);
+
+    std::vector<std::thread> workers_;
+    std::vector<TaskQueue> queues_;
+
+    std::mutex runLock_;    // held for a whole run(), so batches do not overlap
+    std::mutex lock_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::vector<std::function<void()> >* batch_;
+    unsigned long generation_;
+    unsigned int busy_;
+    bool stop_;
+    std::exception_ptr error_;
+};
+
+/**
+* Starts threads - 1 workers; 0 means one thread per hardware core.
+*/
+inline WorkStealingPool::WorkStealingPool(unsigned int threads) :
+        queues_(threads == 0 ? std::max(std::thread::hardware_concurrency(), 1u) : threads),
+        batch_(NULL),
+        generation_(0),
+        busy_(0),
+        stop_(false)
+{
+    for(unsigned int i = 1; i < queues_.size(); i++){
+        workers_.push_back(std::thread(&WorkStealingPool::workerLoop, this, i));
+    }
+}
+
+/**
+* Stops and joins the workers. Must not be called while run() is active.
+*/
+inline WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for(size_t i = 0; i < workers_.size(); i++){
+        workers_[i].join();
+    }
+}
+
+/**
+* Number of threads that execute tasks, including the caller of run().
+*/
+inline unsigned int WorkStealingPool::size() const
+{
+    return (unsigned int)queues_.size();
+}
+
+/**
+* A process-wide pool with one thread per core, created on first use.
+*/
+inline WorkStealingPool& WorkStealingPool::shared()
+{
+    static WorkStealingPool pool;
+    return pool;
+}
+
+/**
+* The pool the calling thread is doing tasks for, or NULL.
+*/
+inline WorkStealingPool*& WorkStealingPool::active()
+{
+    static thread_local WorkStealingPool* pool = NULL;
+    return pool;
+}
+
+/**
+* Runs every task and returns once all of them are done. If a task
+* throws, the first exception is rethrown here after the rest finish.
+*/
+inline void WorkStealingPool::run(const std::vector<std::function<void()> >& tasks)
+{
+    if(tasks.empty()){
+        return;
+    }
+    if(active() == this){
+        runInline(tasks);
+        return;
+    }
+
+    std::lock_guard<std::mutex> serial(runLock_);
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        for(size_t i = 0; i < tasks.size(); i++){
+            TaskQueue& queue = queues_[i % queues_.size()];
+            std::lock_guard<std::mutex> queueGuard(queue.lock);
+            queue.tasks.push_back(i);
+        }
+        batch_ = &tasks;
+        error_ = std::exception_ptr();
+        busy_ = (unsigned int)workers_.size();
+        generation_++;
+    }
+    wake_.notify_all();
+
+    WorkStealingPool* outer = active();
+    active() = this;
+    work(0);
+    active() = outer;
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> guard(lock_);
+        while(busy_ > 0){
+            done_.wait(guard);
+        }
+        batch_ = NULL;
+        error = error_;
+    }
+    if(error){
+        std::rethrow_exception(error);
+    }
+}
+
+inline void WorkStealingPool::runInline(const std::vector<std::function<void()> >& tasks)
+{
+    std::exception_ptr error;
+    for(size_t i = 0; i < tasks.size(); i++){
+        try{
+            tasks[i]();
+        }
+        catch(...){
+            if(!error){
+                error = std::current_exception();
+            }
+        }
+    }
+    if(error){
+        std::rethrow_exception(error);
+    }
+}
+
+/**
+* Pops a task index from our own deque, or steals one from another worker.
+*/
+inline bool WorkStealingPool::take(unsigned int self, size_t& task)
+{
+    {
+        TaskQueue& own = queues_[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if(!own.tasks.empty()){
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for(size_t i = 1; i < queues_.size(); i++){
+        TaskQueue& victim = queues_[(self + i) % queues_.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if(!victim.tasks.empty()){
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+* Executes tasks until none are left in any deque.
+*/
+inline void WorkStealingPool::work(unsigned int self)
+{
+    size_t task;
+    while(take(self, task)){
+        try{
+            (*batch_)[task]();
+        }
+        catch(...){
+            std::lock_guard<std::mutex> guard(lock_);
+            if(!error_){
+                error_ = std::current_exception();
+            }
+        }
+    }
+}
+
+inline void WorkStealingPool::workerLoop(unsigned int self)
+{
+    active() = this;
+    unsigned long seen = 0;
+    while(true){
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+            while(!stop_ && generation_ == seen){
+                wake_.wait(guard);
+            }
+            if(stop_){
+                return;
+            }
+            seen = generation_;
+        }
+
+        work(self);
+
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            busy_--;
+        }
+        done_.notify_all();
+    }
+}
+
+#endif
@@ -0,0 +1,259 @@
+#ifndef THREADEDAVL_H
+#define THREADEDAVL_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include "avlbst.h"
+
+/**
+* An AVL node that also links to its in-order neighbours.
+*/
+template <typename Key, typename Value>
+class ThreadedAVLNode : public AVLNode<Key, Value>
+{
+public:
+    ThreadedAVLNode(const Key& key, const Value& value);
+    virtual ~ThreadedAVLNode();
+
+    ThreadedAVLNode<Key, Value>* getNext() const;
+    ThreadedAVLNode<Key, Value>* getPrevious() const;
+    void setNext(ThreadedAVLNode<Key, Value>* next);
+    void setPrevious(ThreadedAVLNode<Key, Value>* previous);
+
+    virtual ThreadedAVLNode<Key, Value>* getParent() const override;
+    virtual ThreadedAVLNode<Key, Value>* getLeft() const override;
+    virtual ThreadedAVLNode<Key, Value>* getRight() const override;
+
+protected:
+    ThreadedAVLNode<Key, Value>* next_;
+    ThreadedAVLNode<Key, Value>* previous_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the ThreadedAVLNode class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value>::ThreadedAVLNode(const Key& key, const Value& value) :
+        AVLNode<Key, Value>(key, value, NULL), next_(NULL), previous_(NULL)
+{
+
+}
+
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value>::~ThreadedAVLNode()
+{
+
+}
+
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value>* ThreadedAVLNode<Key, Value>::getNext() const
+{
+    return next_;
+}
+
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value>* ThreadedAVLNode<Key, Value>::getPrevious() const
+{
+    return previous_;
+}
+
+template<class Key, class Value>
+void ThreadedAVLNode<Key, Value>::setNext(ThreadedAVLNode<Key, Value>* next)
+{
+    next_ = next;
+}
+
+template<class Key, class Value>
+void ThreadedAVLNode<Key, Value>::setPrevious(ThreadedAVLNode<Key, Value>* previous)
+{
+    previous_ = previous;
+}
+
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value> *ThreadedAVLNode<Key, Value>::getParent() const
+{
+    return static_cast<ThreadedAVLNode<Key, Value>*>(this->parent_);
+}
+
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value> *ThreadedAVLNode<Key, Value>::getLeft() const
+{
+    return static_cast<ThreadedAVLNode<Key, Value>*>(this->left_);
+}
+
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value> *ThreadedAVLNode<Key, Value>::getRight() const
+{
+    return static_cast<ThreadedAVLNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the ThreadedAVLNode class.
+  -----------------------------------------------
+*/
+
+/**
+* An AVL tree whose nodes are threaded in key order, so an iterator step
+* is one load from the node it is on instead of a walk down a right
+* subtree or up past the ancestors it is the right child of.
+*
+* The threads are kept as two extra links per node rather than in the
+* empty child slots: every engine treats a NULL child as "no child", and
+* rotations, joins and the predecessor swap in remove all keep the key
+* order, so only the places that add or drop a node touch the threads.
+* A new leaf is spliced in next to its parent and a removed node is
+* spliced out. The batch operations and compact() relink the whole
+* chain in one O(n) pass afterwards.
+*/
+template <class Key, class Value>
+class ThreadedAVLTree : public AVLTree<Key, Value>
+{
+public:
+    typedef ThreadedAVLNode<Key, Value> ThreadNode;
+
+protected:
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value);
+    virtual size_t nodeSize() const;
+    virtual Node<Key, Value>* relocateNode(Node<Key, Value>* node, NodeArena& arena);
+    virtual void nodeMoved(Node<Key, Value>* from, Node<Key, Value>* to);
+
+    virtual void trackInsert(Node<Key, Value>* leaf);
+    virtual void trackRemoval(Node<Key, Value>* node);
+    virtual void refreshEnds();
+    virtual Node<Key, Value>* nextNode(Node<Key, Value>* node) const;
+    virtual Node<Key, Value>* previousNode(Node<Key, Value>* node) const;
+};
+
+template<class Key, class Value>
+AVLNode<Key, Value>* ThreadedAVLTree<Key, Value>::createNode(const Key& key, const Value& value)
+{
+    return new ThreadNode(key, value);
+}
+
+template<class Key, class Value>
+size_t ThreadedAVLTree<Key, Value>::nodeSize() const
+{
+    return sizeof(ThreadNode);
+}
+
+template<class Key, class Value>
+Node<Key, Value>* ThreadedAVLTree<Key, Value>::relocateNode(Node<Key, Value>* node, NodeArena& arena)
+{
+    return arena.copy(*static_cast<ThreadNode*>(node));
+}
+
+/**
+* The copy has the original's links; its neighbours are pointed at it.
+*/
+template<class Key, class Value>
+void ThreadedAVLTree<Key, Value>::nodeMoved(Node<Key, Value>* from, Node<Key, Value>* to)
+{
+    ThreadNode* copy = static_cast<ThreadNode*>(to);
+    if(copy->getPrevious() != NULL){
+        copy->getPrevious()->setNext(copy);
+    }
+    if(copy->getNext() != NULL){
+        copy->getNext()->setPrevious(copy);
+    }
+    AVLTree<Key, Value>::nodeMoved(from, to);
+}
+
+/**
+* A left child comes just before its parent, a right child just after.
+*/
+template<class Key, class Value>
+void ThreadedAVLTree<Key, Value>::trackInsert(Node<Key, Value>* leaf)
+{
+    AVLTree<Key, Value>::trackInsert(leaf);
+    ThreadNode* added = static_cast<ThreadNode*>(leaf);
+    ThreadNode* parent = added->getParent();
+    ThreadNode* previous = NULL;
+    ThreadNode* next = NULL;
+    if(parent != NULL && parent->getLeft() == added){
+        previous = parent->getPrevious();
+        next = parent;
+    }
+    else if(parent != NULL){
+        previous = parent;
+        next = parent->getNext();
+    }
+    added->setPrevious(previous);
+    added->setNext(next);
+    if(previous != NULL){
+        previous->setNext(added);
+    }
+    if(next != NULL){
+        next->setPrevious(added);
+    }
+}
+
+/**
+* The links are those of the node's key. nodeSwap may have handed the
+* node its predecessor's place, and with it the leftmost_ role, so the
+* ends are taken from the links rather than from the tree.
+*/
+template<class Key, class Value>
+void ThreadedAVLTree<Key, Value>::trackRemoval(Node<Key, Value>* node)
+{
+    ThreadNode* removed = static_cast<ThreadNode*>(node);
+    ThreadNode* previous = removed->getPrevious();
+    ThreadNode* next = removed->getNext();
+    if(previous == NULL){
+        this->leftmost_ = next;
+    }
+    else if(this->leftmost_ == removed){
+        this->leftmost_ = previous;
+    }
+    if(next == NULL){
+        this->rightmost_ = previous;
+    }
+    else if(this->rightmost_ == removed){
+        this->rightmost_ = next;
+    }
+    if(previous != NULL){
+        previous->setNext(next);
+    }
+    if(next != NULL){
+        next->setPrevious(previous);
+    }
+}
+
+/**
+* Relinks every node in one in-order walk.
+*/
+template<class Key, class Value>
+void ThreadedAVLTree<Key, Value>::refreshEnds()
+{
+    AVLTree<Key, Value>::refreshEnds();
+    ThreadNode* previous = NULL;
+    for(Node<Key, Value>* current = this->leftmost_; current != NULL; current = this->successor(current)){
+        ThreadNode* node = static_cast<ThreadNode*>(current);
+        node->setPrevious(previous);
+        if(previous != NULL){
+            previous->setNext(node);
+        }
+        previous = node;
+    }
+    if(previous != NULL){
+        previous->setNext(NULL);
+    }
+}
+
+template<class Key, class Value>
+Node<Key, Value>* ThreadedAVLTree<Key, Value>::nextNode(Node<Key, Value>* node) const
+{
+    return (node == NULL) ? this->leftmost_ : static_cast<ThreadNode*>(node)->getNext();
+}
+
+template<class Key, class Value>
+Node<Key, Value>* ThreadedAVLTree<Key, Value>::previousNode(Node<Key, Value>* node) const
+{
+    return (node == NULL) ? this->rightmost_ : static_cast<ThreadNode*>(node)->getPrevious();
+}
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef TREAPBST_H
+#define TREAPBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include "bst.h"
+
+/**
+* A node for a treap, which adds a random heap priority as a data member.
+*/
+template <typename Key, typename Value>
+class TreapNode : public Node<Key, Value>
+{
+public:
+    TreapNode(const Key& key, const Value& value, TreapNode<Key, Value>* parent, uint32_t priority);
+    virtual ~TreapNode();
+
+    uint32_t getPriority() const;
+    void setPriority(uint32_t priority);
+
+    virtual TreapNode<Key, Value>* getParent() const override;
+    virtual TreapNode<Key, Value>* getLeft() const override;
+    virtual TreapNode<Key, Value>* getRight() const override;
+
+protected:
+    uint32_t priority_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the TreapNode class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+TreapNode<Key, Value>::TreapNode(const Key& key, const Value& value, TreapNode<Key, Value> *parent, uint32_t priority) :
+        Node<Key, Value>(key, value, parent), priority_(priority)
+{
+
+}
+
+template<class Key, class Value>
+TreapNode<Key, Value>::~TreapNode()
+{
+
+}
+
+template<class Key, class Value>
+uint32_t TreapNode<Key, Value>::getPriority() const
+{
+    return priority_;
+}
+
+template<class Key, class Value>
+void TreapNode<Key, Value>::setPriority(uint32_t priority)
+{
+    priority_ = priority;
+}
+
+template<class Key, class Value>
+TreapNode<Key, Value> *TreapNode<Key, Value>::getParent() const
+{
+    return static_cast<TreapNode<Key, Value>*>(this->parent_);
+}
+
+template<class Key, class Value>
+TreapNode<Key, Value> *TreapNode<Key, Value>::getLeft() const
+{
+    return static_cast<TreapNode<Key, Value>*>(this->left_);
+}
+
+template<class Key, class Value>
+TreapNode<Key, Value> *TreapNode<Key, Value>::getRight() const
+{
+    return static_cast<TreapNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the TreapNode class.
+  -----------------------------------------------
+*/
+
+/**
+* A treap: a search tree on the keys that is also a max-heap on random
+* priorities, which keeps the expected depth O(log n). An update does
+* fewer than two rotations on average and needs no balance bookkeeping.
+*/
+template <class Key, class Value>
+class Treap : public BinarySearchTree<Key, Value>
+{
+public:
+    explicit Treap(uint32_t seed = 0x9E3779B9u);
+
+    virtual void remove(const Key& key);
+    using BinarySearchTree<Key, Value>::remove;
+
+    virtual void rebalance();
+
+protected:
+    virtual Node<Key, Value>* insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item);
+    virtual size_t nodeSize() const;
+    virtual Node<Key, Value>* relocateNode(Node<Key, Value>* node, NodeArena& arena);
+    uint32_t nextPriority();
+    void rankLevels(TreapNode<Key, Value>* root, int depth, int height, uint32_t band);
+
+    uint32_t state_;    // xorshift32 state for the priorities
+};
+
+template<class Key, class Value>
+Treap<Key, Value>::Treap(uint32_t seed) : state_(seed == 0 ? 1 : seed)
+{
+
+}
+
+template<class Key, class Value>
+size_t Treap<Key, Value>::nodeSize() const
+{
+    return sizeof(TreapNode<Key, Value>);
+}
+
+template<class Key, class Value>
+Node<Key, Value>* Treap<Key, Value>::relocateNode(Node<Key, Value>* node, NodeArena& arena)
+{
+    return arena.copy(*static_cast<TreapNode<Key, Value>*>(node));
+}
+
+template<class Key, class Value>
+uint32_t Treap<Key, Value>::nextPriority()
+{
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    return state_;
+}
+
+/**
+* DSW ignores the priorities, so they are drawn again by level: the
+* priority range is cut into one band per level, highest at the root, and
+* each node gets a random priority within its level's band. That restores
+* the heap order; later inserts draw from the whole range as before.
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::rebalance()
+{
+    BinarySearchTree<Key, Value>::rebalance();
+    int height = this->getHeight(this->root_) + 1;    // levels
+    if(height > 0){
+        uint32_t band = (uint32_t)std::min<uint64_t>(0xFFFFFFFFULL, 0x100000000ULL / height);
+        rankLevels(static_cast<TreapNode<Key, Value>*>(this->root_), 0, height, band);
+    }
+}
+
+template<class Key, class Value>
+void Treap<Key, Value>::rankLevels(TreapNode<Key, Value>* root, int depth, int height, uint32_t band)
+{
+    if(root == NULL){
+        return;
+    }
+    root->setPriority((uint32_t)(height - 1 - depth) * band + nextPriority() % band);
+    rankLevels(root->getLeft(), depth + 1, height, band);
+    rankLevels(root->getRight(), depth + 1, height, band);
+}
+
+/*
+ * If key is already in the tree, the value is overwritten. Otherwise the
+ * new leaf is rotated up while it outranks its parent.
+ */
+template<class Key, class Value>
+Node<Key, Value>* Treap<Key, Value>::insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item)
+{
+    Node<Key, Value>* parent;
+    Node<Key, Value>* existing = this->findInsertPoint(start, new_item.first, parent);
+    if(existing != NULL){
+        existing->setValue(new_item.second);
+        return existing;
+    }
+
+    TreapNode<Key, Value>* addition = new TreapNode<Key, Value>(new_item.first, new_item.second, NULL, nextPriority());
+    this->attachLeaf(parent, addition);
+
+    while(addition->getParent() != NULL && addition->getParent()->getPriority() < addition->getPriority()){
+        if(addition == addition->getParent()->getLeft()){
+            this->rotateRightNode(addition->getParent());
+        }
+        else{
+            this->rotateLeftNode(addition->getParent());
+        }
+    }
+    return addition;
+}
+
+/*
+ * The node is rotated down, always lifting its higher priority child,
+ * until it has at most one child, and then unlinked.
+ */
+template<class Key, class Value>
+void Treap<Key, Value>::remove(const Key& key)
+{
+    TreapNode<Key, Value>* current = static_cast<TreapNode<Key, Value>*>(this->internalFind(key));
+    if(current == NULL){
+        return;
+    }
+
+    while(this->twoChild(current)){
+        if(current->getLeft()->getPriority() > current->getRight()->getPriority()){
+            this->rotateRightNode(current);
+        }
+        else{
+            this->rotateLeftNode(current);
+        }
+    }
+    this->trackRemoval(current);
+
+    Node<Key, Value>* child = (current->getLeft() != NULL) ? current->getLeft() : current->getRight();
+    this->replaceChild(current->getParent(), current, child);
+    delete current;
+    this->manyNodes--;
+}
+
+#endif
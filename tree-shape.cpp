@@ -0,0 +1,221 @@
+#include <vector>
+#include <functional>
+#include <climits>
+#include <algorithm>
+#include <cstdlib>
+#include "tree-shape.h"
+using namespace std;
+
+
+TreeShape::TreeShape() :
+    nodes(0), leaves(0), oneChildNodes(0), height(0),
+    minLeafDepth(-1), maxLeafDepth(-1),
+    maxHeightDifference(0), unbalancedNodes(0)
+{
+}
+
+double TreeShape::averageLeafDepth() const
+{
+    if(leaves == 0){
+        return 0.0;
+    }
+    double total = 0;
+    for(size_t depth = 0; depth < leafDepths.size(); depth++){
+        total += (double)depth * leafDepths[depth];
+    }
+    return total / leaves;
+}
+
+/**
+ * Same answer as ::equalPaths for the analyzed tree.
+ */
+bool TreeShape::equalPaths() const
+{
+    return minLeafDepth == maxLeafDepth;
+}
+
+namespace {
+
+struct Frame {
+    Node* node;
+    int depth;
+    int stage;          // 0: not entered, 1: left subtree done, 2: both done
+    int leftHeight;
+};
+
+void addLeaf(TreeShape& shape, int depth)
+{
+    shape.leaves++;
+    if((int)shape.leafDepths.size() <= depth){
+        shape.leafDepths.resize(depth + 1, 0);
+    }
+    shape.leafDepths[depth]++;
+    if(shape.minLeafDepth < 0 || depth < shape.minLeafDepth){
+        shape.minLeafDepth = depth;
+    }
+    shape.maxLeafDepth = max(shape.maxLeafDepth, depth);
+}
+
+/**
+ * Adds the counts of part, a disjoint subtree analyzed on its own with
+ * absolute depths, into shape.
+ */
+void mergeShape(TreeShape& shape, const TreeShape& part)
+{
+    shape.nodes += part.nodes;
+    shape.leaves += part.leaves;
+    shape.oneChildNodes += part.oneChildNodes;
+    shape.unbalancedNodes += part.unbalancedNodes;
+    shape.maxHeightDifference = max(shape.maxHeightDifference, part.maxHeightDifference);
+    if(shape.leafDepths.size() < part.leafDepths.size()){
+        shape.leafDepths.resize(part.leafDepths.size(), 0);
+    }
+    for(size_t depth = 0; depth < part.leafDepths.size(); depth++){
+        shape.leafDepths[depth] += part.leafDepths[depth];
+    }
+    if(part.minLeafDepth >= 0 && (shape.minLeafDepth < 0 || part.minLeafDepth < shape.minLeafDepth)){
+        shape.minLeafDepth = part.minLeafDepth;
+    }
+    shape.maxLeafDepth = max(shape.maxLeafDepth, part.maxLeafDepth);
+}
+
+/**
+ * Post-order walk of root's subtree (root at the given depth) that adds
+ * everything but the height into shape and returns the subtree's height.
+ * Nodes at depth cut are not entered: cutAt(node) accounts for their
+ * subtrees and returns the height.
+ */
+int walkShape(Node* root, int depth, int cut, TreeShape& shape, const function<int(Node*)>& cutAt)
+{
+    if(root == NULL){
+        return 0;
+    }
+
+    vector<Frame> stack;
+    Frame first = { root, depth, 0, 0 };
+    stack.push_back(first);
+    int result = 0;
+    while(!stack.empty()){
+        Frame& top = stack.back();
+        Node* current = top.node;
+
+        if(top.stage == 0){
+            if(top.depth == cut){
+                result = cutAt(current);
+                stack.pop_back();
+                continue;
+            }
+            shape.nodes++;
+            if(current->left == NULL && current->right == NULL){
+                addLeaf(shape, top.depth);
+                result = 1;
+                stack.pop_back();
+                continue;
+            }
+            if(current->left == NULL || current->right == NULL){
+                shape.oneChildNodes++;
+            }
+            top.stage = 1;
+            result = 0;
+            if(current->left != NULL){
+                Frame child = { current->left, top.depth + 1, 0, 0 };
+                stack.push_back(child);
+            }
+        }
+        else if(top.stage == 1){
+            top.leftHeight = result;
+            top.stage = 2;
+            result = 0;
+            if(current->right != NULL){
+                Frame child = { current->right, top.depth + 1, 0, 0 };
+                stack.push_back(child);
+            }
+        }
+        else{
+            int difference = abs(top.leftHeight - result);
+            shape.maxHeightDifference = max(shape.maxHeightDifference, difference);
+            if(difference > 1){
+                shape.unbalancedNodes++;
+            }
+            result = 1 + max(top.leftHeight, result);
+            stack.pop_back();
+        }
+    }
+    return result;
+}
+
+int neverCut(Node*)
+{
+    return 0;
+}
+
+/**
+ * True if the tree at root has at least limit nodes; stops counting there.
+ */
+bool hasAtLeast(Node* root, long limit)
+{
+    long count = 0;
+    vector<Node*> stack;
+    if(root != NULL){
+        stack.push_back(root);
+    }
+    while(!stack.empty() && count < limit){
+        Node* node = stack.back();
+        stack.pop_back();
+        count++;
+        if(node->left != NULL){
+            stack.push_back(node->left);
+        }
+        if(node->right != NULL){
+            stack.push_back(node->right);
+        }
+    }
+    return count >= limit;
+}
+
+}
+
+TreeShape analyzeShape(Node * root)
+{
+    TreeShape shape;
+    shape.height = walkShape(root, 0, INT_MAX, shape, neverCut);
+    return shape;
+}
+
+TreeShape analyzeShapeParallel(Node * root, WorkStealingPool& pool, long minNodes)
+{
+    if(pool.size() < 2 || !hasAtLeast(root, minNodes)){
+        return analyzeShape(root);
+    }
+
+    // cut deep enough for about eight subtrees per thread
+    int cut = 0;
+    while((1u << cut) < 8 * pool.size() && cut < 30){
+        cut++;
+    }
+
+    vector<Node*> pieces;
+    TreeShape ignored;
+    walkShape(root, 0, cut, ignored, [&pieces](Node* node) { pieces.push_back(node); return 0; });
+    if(pieces.size() < 2 * (size_t)pool.size()){
+        return analyzeShape(root);
+    }
+
+    vector<TreeShape> parts(pieces.size());
+    vector<int> heights(pieces.size());
+    vector<function<void()> > tasks;
+    for(size_t i = 0; i < pieces.size(); i++){
+        tasks.push_back([&, i]() { heights[i] = walkShape(pieces[i], cut, INT_MAX, parts[i], neverCut); });
+    }
+    pool.run(tasks);
+
+    // the top levels again, taking each cut subtree's results in the
+    // order the first walk found them
+    TreeShape shape;
+    size_t next = 0;
+    shape.height = walkShape(root, 0, cut, shape, [&](Node*) {
+        mergeShape(shape, parts[next]);
+        return heights[next++];
+    });
+    return shape;
+}
@@ -0,0 +1,61 @@
+#ifndef TREE_SHAPE_H
+#define TREE_SHAPE_H
+
+#include <vector>
+#include "equal-paths.h"
+#include "thread_pool.h"
+
+/**
+ * Shape of a tree of Nodes, as gathered by analyzeShape. Depths count
+ * edges from the root (the root is at depth 0); height counts levels, so
+ * an empty tree has height 0 and a single node height 1.
+ */
+struct TreeShape {
+    long nodes;
+    long leaves;
+    long oneChildNodes;
+    int height;
+    int minLeafDepth;               // -1 for an empty tree
+    int maxLeafDepth;               // -1 for an empty tree
+    std::vector<long> leafDepths;   // leafDepths[d]: number of leaves at depth d
+
+    // Imbalance: the largest difference between the heights of a node's
+    // two subtrees, and the number of nodes where it is more than 1 (the
+    // nodes an AVL tree would rotate at).
+    int maxHeightDifference;
+    long unbalancedNodes;
+
+    TreeShape();
+
+    double averageLeafDepth() const;
+    bool equalPaths() const;
+};
+
+/**
+ * @brief Gathers every field of TreeShape in one pass, with an explicit
+ *        stack, so any depth of tree works. O(n).
+ *
+ * @param root Pointer to the root of the tree to analyze
+ */
+TreeShape analyzeShape(Node * root);
+
+/**
+ * @brief The same result, with the subtrees a few levels below the root
+ *        analyzed on the pool in parallel. Trees of fewer than minNodes
+ *        nodes (counted up to minNodes only), trees too narrow near the
+ *        root to give every thread work (e.g. long chains) and one-thread
+ *        pools are done in one pass on the calling thread, where handing
+ *        out the work would cost more than it saves. The tree must not
+ *        change meanwhile.
+ *
+ *        Not meant to be called from a task running on pool: run() then
+ *        does the subtrees inline, one after another.
+ *
+ * @param root Pointer to the root of the tree to analyze
+ * @param pool Threads to use
+ * @param minNodes Smallest tree worth splitting
+ */
+TreeShape analyzeShapeParallel(Node * root, WorkStealingPool& pool = WorkStealingPool::shared(),
+                               long minNodes = 16384);
+
+#endif
@@ -0,0 +1,347 @@
+#ifndef WAVLBST_H
+#define WAVLBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include "bst.h"
+
+/**
+* A node for a weak AVL tree, which adds the rank as a data member.
+* Leaves have rank 0 and a missing child counts as rank -1.
+*/
+template <typename Key, typename Value>
+class WAVLNode : public Node<Key, Value>
+{
+public:
+    WAVLNode(const Key& key, const Value& value, WAVLNode<Key, Value>* parent);
+    virtual ~WAVLNode();
+
+    int8_t getRank() const;
+    void setRank(int8_t rank);
+    void updateRank(int8_t diff);
+
+    virtual WAVLNode<Key, Value>* getParent() const override;
+    virtual WAVLNode<Key, Value>* getLeft() const override;
+    virtual WAVLNode<Key, Value>* getRight() const override;
+
+protected:
+    int8_t rank_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the WAVLNode class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+WAVLNode<Key, Value>::WAVLNode(const Key& key, const Value& value, WAVLNode<Key, Value> *parent) :
+        Node<Key, Value>(key, value, parent), rank_(0)
+{
+
+}
+
+template<class Key, class Value>
+WAVLNode<Key, Value>::~WAVLNode()
+{
+
+}
+
+template<class Key, class Value>
+int8_t WAVLNode<Key, Value>::getRank() const
+{
+    return rank_;
+}
+
+template<class Key, class Value>
+void WAVLNode<Key, Value>::setRank(int8_t rank)
+{
+    rank_ = rank;
+}
+
+template<class Key, class Value>
+void WAVLNode<Key, Value>::updateRank(int8_t diff)
+{
+    rank_ += diff;
+}
+
+template<class Key, class Value>
+WAVLNode<Key, Value> *WAVLNode<Key, Value>::getParent() const
+{
+    return static_cast<WAVLNode<Key, Value>*>(this->parent_);
+}
+
+template<class Key, class Value>
+WAVLNode<Key, Value> *WAVLNode<Key, Value>::getLeft() const
+{
+    return static_cast<WAVLNode<Key, Value>*>(this->left_);
+}
+
+template<class Key, class Value>
+WAVLNode<Key, Value> *WAVLNode<Key, Value>::getRight() const
+{
+    return static_cast<WAVLNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the WAVLNode class.
+  -----------------------------------------------
+*/
+
+/**
+* A weak AVL tree (Haeupler, Sen and Tarjan). Every rank difference is 1
+* or 2 and leaves are 1,1. Built by inserts alone it is an AVL tree; on
+* removal it relaxes instead of rotating, so each update does at most two
+* rotations and O(1) amortized rank changes, and the height stays under
+* 2 log n.
+*/
+template <class Key, class Value>
+class WAVLTree : public BinarySearchTree<Key, Value>
+{
+public:
+    virtual void remove(const Key& key);
+    using BinarySearchTree<Key, Value>::remove;
+
+    virtual void rebalance();
+
+protected:
+    virtual Node<Key, Value>* insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item);
+    virtual void nodeSwap(Node<Key, Value>* n1, Node<Key, Value>* n2);
+    virtual size_t nodeSize() const;
+    virtual Node<Key, Value>* relocateNode(Node<Key, Value>* node, NodeArena& arena);
+
+    static int rank(WAVLNode<Key, Value>* node);
+    void fixInsert(WAVLNode<Key, Value>* node);
+    void fixRemove(WAVLNode<Key, Value>* node, WAVLNode<Key, Value>* parent);
+    static int restoreRanks(WAVLNode<Key, Value>* root);
+};
+
+/**
+* A missing child has rank -1.
+*/
+template<class Key, class Value>
+int WAVLTree<Key, Value>::rank(WAVLNode<Key, Value>* node)
+{
+    return (node == NULL) ? -1 : node->getRank();
+}
+
+template<class Key, class Value>
+size_t WAVLTree<Key, Value>::nodeSize() const
+{
+    return sizeof(WAVLNode<Key, Value>);
+}
+
+template<class Key, class Value>
+Node<Key, Value>* WAVLTree<Key, Value>::relocateNode(Node<Key, Value>* node, NodeArena& arena)
+{
+    return arena.copy(*static_cast<WAVLNode<Key, Value>*>(node));
+}
+
+/**
+* Ranks belong to the places in the tree, so they swap with the nodes.
+*/
+template<class Key, class Value>
+void WAVLTree<Key, Value>::nodeSwap(Node<Key, Value>* n1, Node<Key, Value>* n2)
+{
+    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    WAVLNode<Key, Value>* w1 = static_cast<WAVLNode<Key, Value>*>(n1);
+    WAVLNode<Key, Value>* w2 = static_cast<WAVLNode<Key, Value>*>(n2);
+    int8_t tempRank = w1->getRank();
+    w1->setRank(w2->getRank());
+    w2->setRank(tempRank);
+}
+
+/**
+* DSW leaves a complete tree, where rank = height - 1 makes every rank
+* difference 1 or 2 and every leaf 1,1.
+*/
+template<class Key, class Value>
+void WAVLTree<Key, Value>::rebalance()
+{
+    BinarySearchTree<Key, Value>::rebalance();
+    restoreRanks(static_cast<WAVLNode<Key, Value>*>(this->root_));
+}
+
+/**
+* Sets every rank below root to its height - 1 and returns root's rank.
+*/
+template<class Key, class Value>
+int WAVLTree<Key, Value>::restoreRanks(WAVLNode<Key, Value>* root)
+{
+    if(root == NULL){
+        return -1;
+    }
+    int left = restoreRanks(root->getLeft());
+    int right = restoreRanks(root->getRight());
+    int rank = std::max(left, right) + 1;
+    root->setRank((int8_t)rank);
+    return rank;
+}
+
+/*
+ * If key is already in the tree, the value is overwritten.
+ */
+template<class Key, class Value>
+Node<Key, Value>* WAVLTree<Key, Value>::insertFrom(Node<Key, Value>* start, const std::pair<const Key, Value>& new_item)
+{
+    Node<Key, Value>* parent;
+    Node<Key, Value>* existing = this->findInsertPoint(start, new_item.first, parent);
+    if(existing != NULL){
+        existing->setValue(new_item.second);
+        return existing;
+    }
+
+    WAVLNode<Key, Value>* addition = new WAVLNode<Key, Value>(new_item.first, new_item.second, NULL);
+    this->attachLeaf(parent, addition);
+    fixInsert(addition);
+    return addition;
+}
+
+/**
+* node has just become a 0-child of its parent. Promotes up the tree while
+* the sibling is a 1-child, then finishes with a single or double rotation.
+*/
+template<class Key, class Value>
+void WAVLTree<Key, Value>::fixInsert(WAVLNode<Key, Value>* node)
+{
+    WAVLNode<Key, Value>* parent = node->getParent();
+    while(parent != NULL && parent->getRank() == node->getRank()){
+        bool isLeft = (parent->getLeft() == node);
+        WAVLNode<Key, Value>* sibling = isLeft ? parent->getRight() : parent->getLeft();
+
+        if(parent->getRank() - rank(sibling) == 1){
+            parent->updateRank(1);
+            node = parent;
+            parent = node->getParent();
+            continue;
+        }
+
+        // parent is 0,2: rotate
+        WAVLNode<Key, Value>* inner = isLeft ? node->getRight() : node->getLeft();
+        if(inner == NULL || node->getRank() - inner->getRank() == 2){
+            if(isLeft){
+                this->rotateRightNode(parent);
+            }
+            else{
+                this->rotateLeftNode(parent);
+            }
+            parent->updateRank(-1);
+        }
+        else{
+            if(isLeft){
+                this->rotateLeftNode(node);
+                this->rotateRightNode(parent);
+            }
+            else{
+                this->rotateRightNode(node);
+                this->rotateLeftNode(parent);
+            }
+            inner->updateRank(1);
+            node->updateRank(-1);
+            parent->updateRank(-1);
+        }
+        return;
+    }
+}
+
+/*
+ * A node with two children is swapped with its predecessor first, like
+ * the other trees, so it has at most one child when it is unlinked.
+ */
+template<class Key, class Value>
+void WAVLTree<Key, Value>::remove(const Key& key)
+{
+    WAVLNode<Key, Value>* current = static_cast<WAVLNode<Key, Value>*>(this->internalFind(key));
+    if(current == NULL){
+        return;
+    }
+
+    if(this->twoChild(current)){
+        nodeSwap(current, this->predecessor(current));
+    }
+    this->trackRemoval(current);
+
+    WAVLNode<Key, Value>* parent = current->getParent();
+    WAVLNode<Key, Value>* child = (current->getLeft() != NULL) ? current->getLeft() : current->getRight();
+    this->replaceChild(parent, current, child);
+    delete current;
+    this->manyNodes--;
+
+    fixRemove(child, parent);
+}
+
+/**
+* Repairs the ranks above an unlinked node, whose place is now taken by
+* node (possibly NULL). Handles a parent left as a 2,2 leaf, then demotes
+* up the tree while node is a 3-child, ending with at most one single or
+* double rotation.
+*/
+template<class Key, class Value>
+void WAVLTree<Key, Value>::fixRemove(WAVLNode<Key, Value>* node, WAVLNode<Key, Value>* parent)
+{
+    if(parent == NULL){
+        return;
+    }
+    if(parent->getLeft() == NULL && parent->getRight() == NULL && parent->getRank() == 1){
+        parent->setRank(0);
+        node = parent;
+        parent = node->getParent();
+    }
+
+    while(parent != NULL && parent->getRank() - rank(node) == 3){
+        // a NULL node with a NULL left slot is the left child; the sibling
+        // of a 3-child always exists
+        bool isLeft = (node != NULL) ? (parent->getLeft() == node) : (parent->getLeft() == NULL);
+        WAVLNode<Key, Value>* sibling = isLeft ? parent->getRight() : parent->getLeft();
+
+        if(parent->getRank() - sibling->getRank() == 2){
+            parent->updateRank(-1);
+            node = parent;
+            parent = node->getParent();
+            continue;
+        }
+        if(sibling->getRank() - rank(sibling->getLeft()) == 2 && sibling->getRank() - rank(sibling->getRight()) == 2){
+            parent->updateRank(-1);
+            sibling->updateRank(-1);
+            node = parent;
+            parent = node->getParent();
+            continue;
+        }
+
+        WAVLNode<Key, Value>* outer = isLeft ? sibling->getRight() : sibling->getLeft();
+        WAVLNode<Key, Value>* inner = isLeft ? sibling->getLeft() : sibling->getRight();
+        if(sibling->getRank() - rank(outer) == 1){
+            if(isLeft){
+                this->rotateLeftNode(parent);
+            }
+            else{
+                this->rotateRightNode(parent);
+            }
+            sibling->updateRank(1);
+            parent->updateRank(-1);
+            if(parent->getLeft() == NULL && parent->getRight() == NULL){
+                parent->updateRank(-1);
+            }
+        }
+        else{
+            if(isLeft){
+                this->rotateRightNode(sibling);
+                this->rotateLeftNode(parent);
+            }
+            else{
+                this->rotateLeftNode(sibling);
+                this->rotateRightNode(parent);
+            }
+            inner->updateRank(2);
+            sibling->updateRank(-1);
+            parent->updateRank(-2);
+        }
+        return;
+    }
+}
+
+#endif